@@ -0,0 +1,323 @@
+/*
+	Benchmarks for the heavy lifting in imgview.c, on synthetic data.
+	Build with "make bench" and run the resulting Benchmark executable.
+	Pass the ones to run as arguments ( e.g. "Benchmark 8k 16k pack1k" ), default is all of them.
+*/
+#define main imgview_main
+#include "imgview.c"
+#undef main
+
+
+static double seconds_since( Uint64 then ){
+	return (SDL_GetPerformanceCounter() - then) / (double) SDL_GetPerformanceFrequency();
+}
+
+static SDL_Surface *synthetic_image( int w, int h ){
+	SDL_Surface *S = SDL_CreateSurface( w, h, SDL_PIXELFORMAT_RGBA32 );
+	if( S == NULL ) return NULL;
+	Uint32 x = 2463534242u;
+	for (int j = 0; j < h; ++j ){
+		Uint8 *row = (Uint8*)S->pixels + j * S->pitch;
+		for (int i = 0; i < w; ++i ){
+			x ^= x << 13; x ^= x >> 17; x ^= x << 5;// xorshift noise over a gradient
+			row[4*i+0] = (i * 255 / w) ^ (x & 15);
+			row[4*i+1] = (j * 255 / h) ^ ((x >> 4) & 15);
+			row[4*i+2] = x >> 24;
+			row[4*i+3] = 255;
+		}
+	}
+	return S;
+}
+
+// load_scale_n_blur's kernel as it was before going separable: full 2D lens, GetRGBA per tap
+static SDL_Surface* scale_n_blur_2D( SDL_Surface *converted, int target_w, int target_h, float blur ){
+
+	SDL_FRect crct = (SDL_FRect){0,0,converted->w, converted->h};
+	SDL_Rect trct = (SDL_Rect){0,0,target_w, target_h};
+	fit_rect( &crct, &trct );
+	target_w = crct.w;
+	target_h = crct.h;
+
+	SDL_Surface* output = SDL_CreateSurface(target_w, target_h, converted->format);
+	float scale = (float)converted->w / target_w;
+	float sigma = scale * 0.5f;
+	int radius = SDL_ceilf(sigma * blur);
+	int lens_len = (2 * radius + 1) * (2 * radius + 1);
+
+	float* lens = SDL_malloc( lens_len * sizeof(float) );
+	float sum = 0.0f;
+	for (int y = -radius; y <= radius; y++) {
+		for (int x = -radius; x <= radius; x++) {
+			float weight = gaussian(SDL_sqrtf(x*x + y*y), sigma);
+			lens[(y + radius) * (2 * radius + 1) + (x + radius)] = weight;
+			sum += weight;
+		}
+	}
+	sum = 1.0 / sum;
+	for (int i = 0; i < lens_len; i++) lens[i] *= sum;
+
+	const SDL_PixelFormatDetails *deets = SDL_GetPixelFormatDetails(output->format);
+	Uint32* src_pixels = (Uint32*)converted->pixels;
+	Uint32* dst_pixels = (Uint32*)output->pixels;
+
+	for (int dst_y = 0; dst_y < target_h; dst_y++) {
+		for (int dst_x = 0; dst_x < target_w; dst_x++) {
+			float src_center_x = dst_x * scale;
+			float src_center_y = dst_y * scale;
+			float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+			for (int ky = -radius; ky <= radius; ky++) {
+				for (int kx = -radius; kx <= radius; kx++) {
+					int src_x = SDL_clamp( (int)(src_center_x + kx), 0, converted->w - 1 );
+					int src_y = SDL_clamp( (int)(src_center_y + ky), 0, converted->h - 1 );
+					SDL_Color color;
+					SDL_GetRGBA(src_pixels[src_y * converted->w + src_x], deets, NULL,
+					            &color.r, &color.g, &color.b, &color.a);
+					float weight = lens[(ky + radius) * (2 * radius + 1) + (kx + radius)];
+					r += color.r * weight;
+					g += color.g * weight;
+					b += color.b * weight;
+					a += color.a * weight;
+				}
+			}
+			dst_pixels[dst_y * target_w + dst_x] = SDL_MapRGBA( deets, NULL,
+				(Uint8)SDL_clamp(r, 0.0f, 255.0f), (Uint8)SDL_clamp(g, 0.0f, 255.0f),
+				(Uint8)SDL_clamp(b, 0.0f, 255.0f), (Uint8)SDL_clamp(a, 0.0f, 255.0f) );
+		}
+	}
+	SDL_free(lens);
+	return output;
+}
+
+static int max_difference( SDL_Surface *A, SDL_Surface *B ){
+	int D = 0;
+	for (int j = 0; j < A->h; ++j ){
+		Uint8 *a = (Uint8*)A->pixels + j * A->pitch;
+		Uint8 *b = (Uint8*)B->pixels + j * B->pitch;
+		for (int i = 0; i < 4 * A->w; ++i ){
+			D = SDL_max( D, SDL_abs( a[i] - b[i] ) );
+		}
+	}
+	return D;
+}
+
+static void bench_scale_n_blur( const char *name, int w, int h ){
+
+	const char *level_names [] = { "scalar", "SSE2", "AVX2" };
+	const int tw = 1920, th = 1080;
+
+	SDL_Surface *S = synthetic_image( w, h );
+	if( S == NULL ){
+		SDL_Log( "%s (%d x %d): couldn't allocate, %s", name, w, h, SDL_GetError() );
+		return;
+	}
+	SDL_Log( "scale_n_blur, %s (%d x %d) -> fit in %d x %d", name, w, h, tw, th );
+
+	Uint64 then = SDL_GetPerformanceCounter();
+	SDL_Surface *before = scale_n_blur_2D( S, tw, th, 1.25 );
+	SDL_Log( "  before (2D kernel):   %8.3f s", seconds_since( then ) );
+
+	Worker_Pool *pool = POOL;
+	POOL = NULL;
+	for (int l = BLUR_SCALAR; l <= BLUR_AVX2; ++l ){
+		if( select_blur_kernels( l ) != l ) continue;
+		then = SDL_GetPerformanceCounter();
+		SDL_Surface *after = scale_n_blur( S, tw, th, 1.25, NULL );
+		SDL_Log( "  separable %-6s      %8.3f s   (max diff: %d)", level_names[l],
+		         seconds_since( then ), max_difference( before, after ) );
+		SDL_DestroySurface( after );
+	}
+	POOL = pool;
+
+	int best = select_blur_kernels( BLUR_AVX2 );
+	then = SDL_GetPerformanceCounter();
+	SDL_Surface *after = scale_n_blur( S, tw, th, 1.25, NULL );
+	SDL_Log( "  %s x %2d workers     %8.3f s   (max diff: %d)", level_names[best], POOL->N,
+	         seconds_since( then ), max_difference( before, after ) );
+	SDL_DestroySurface( after );
+
+	SDL_DestroySurface( before );
+	SDL_DestroySurface( S );
+}
+
+static bool intersecting_or_touching( SDL_Rect *A, SDL_Rect *B ){
+	return ( ( A->x + A->w >= B->x ) && ( B->x + B->w >= A->x ) ) && 
+	       ( ( A->y + A->h >= B->y ) && ( B->y + B->h >= A->y ) );
+}
+
+// pack_imgs as it was before the skyline: every anchor against every placed rect
+static i2d pack_imgs_anchors( Image *imgs, int len ){
+
+	#define rects(i) imgs[i].RCT
+
+	int *ids = SDL_malloc( len * sizeof(int) );
+	for(int i = 0; i < len; i++) ids[i] = i;
+
+	float targetAR = width / (float)height;
+
+	while(1){
+		bool done = 1;
+		for(int i = len-1; i > 0; i--){
+			if( (rects( ids[i] ).w > rects( ids[i-1] ).w && rects( ids[i] ).w > rects( ids[i-1] ).h) ||
+				(rects( ids[i] ).h > rects( ids[i-1] ).w && rects( ids[i] ).h > rects( ids[i-1] ).h) ){
+
+				int temp = ids[i-1];
+				ids[i-1] = ids[i];
+				ids[i] = temp;
+				done = 0;
+			}
+		}
+		if( done ) break;
+	}
+
+	int anchor_size = 2 * len;
+	i2d *anchors = SDL_malloc( anchor_size * sizeof(i2d) );
+
+	int W = rects( ids[0] ).w;
+	int H = rects( ids[0] ).h;
+
+	rects( ids[0] ).x = 0;
+	rects( ids[0] ).y = 0;
+	anchors[0] = (i2d){ W+1, 0 };
+	anchors[1] = (i2d){ 0, H+1 };
+	int anchor_len = 2;
+
+	for(int i = 1; i < len; i++){
+		
+		int A = -1;
+		float best = 999999;
+
+		for(int a = 0; a < anchor_len; a++){
+
+			SDL_Rect candidate = (SDL_Rect){ anchors[a].i, anchors[a].j, rects(ids[i]).w, rects(ids[i]).h };
+
+			bool ouch = 0;
+			for(int j = 0; j < i; j++){
+				if( intersecting_or_touching( &candidate, &(imgs[ ids[j] ].RCT) ) ){
+					ouch = 1;
+					break;
+				}
+			}
+			if( ouch ) continue;
+			
+			int right = anchors[a].i + rects(ids[i]).w;
+			int bottom = anchors[a].j + rects(ids[i]).h;
+			int nw = (right > W)? right : W;
+			int nh = (bottom > H)? bottom : H;
+			if( nw == W && nh == H ){
+				A = a;
+				break;
+			}
+			else{
+				float AR = nw / (float) nh;
+				float S = SDL_fabsf( targetAR - AR );
+				if( S < best ){
+					A = a;
+					best = S;
+				}
+			}
+		}
+
+		rects( ids[i] ).x = anchors[A].i;
+		rects( ids[i] ).y = anchors[A].j;
+		int right = anchors[A].i + rects(ids[i]).w;
+		int bottom = anchors[A].j + rects(ids[i]).h;
+		anchors[A] = (i2d){ rects( ids[i] ).x, bottom + 1 };
+		anchors[ anchor_len++ ] = (i2d){ right + 1, rects( ids[i] ).y };
+		if(right > W) W = right;
+		if(bottom > H) H = bottom;
+	}
+
+	SDL_free( anchors );
+	SDL_free( ids );
+
+
+	return (i2d){ W, H };
+	#undef rects
+}
+
+
+static bool packing_overlaps( Image *imgs, int len ){
+	for (int i = 0; i < len; ++i ){
+		for (int j = 0; j < i; ++j ){
+			if( SDL_HasRectIntersection( &(imgs[i].RCT), &(imgs[j].RCT) ) ) return true;
+		}
+	}
+	return false;
+}
+
+static void bench_packing( const char *name, int n ){
+
+	Image *imgs = SDL_calloc( n, sizeof(Image) );
+	Uint32 x = 2463534242u;
+	for (int i = 0; i < n; ++i ){// mostly photo shapes, some icons and strips
+		x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+		int w = 64 + x % 3000;
+		float ar = ( (x >> 12) % 4 == 0 )? 0.2f + ( (x >> 16) % 100 ) / 20.0f : ( (x >> 16) % 2 ? 1.5f : 0.66f );
+		imgs[i].RCT = (SDL_Rect){ 0, 0, w, SDL_max( 16, (int)( w / ar ) ) };
+	}
+	SDL_Log( "pack_imgs, %s (%d images) into %d x %d", name, n, width, height );
+
+	Uint64 then;
+	if( n <= 1000 ){
+		then = SDL_GetPerformanceCounter();
+		i2d before = pack_imgs_anchors( imgs, n );
+		SDL_Log( "  before (anchors):     %8.3f ms   (%d x %d, shown at %.3f)", 1000 * seconds_since( then ),
+		         before.i, before.j, 1 / pack_fit( before.i, before.j ) );
+	}
+	else SDL_Log( "  before (anchors):     skipped, it's cubic" );
+
+	then = SDL_GetPerformanceCounter();
+	i2d after = pack_imgs( imgs, n );
+	SDL_Log( "  skyline:              %8.3f ms   (%d x %d, shown at %.3f)%s", 1000 * seconds_since( then ),
+	         after.i, after.j, 1 / pack_fit( after.i, after.j ), packing_overlaps( imgs, n )? "  OVERLAPS!" : "" );
+
+	// and the last one dropped in on its own
+	pack_imgs( imgs, n-1 );
+	then = SDL_GetPerformanceCounter();
+	after = pack_one_more( imgs, n );
+	SDL_Log( "  one more dropped in:  %8.3f ms   (%d x %d, shown at %.3f)", 1000 * seconds_since( then ),
+	         after.i, after.j, 1 / pack_fit( after.i, after.j ) );
+
+	free_packing();
+	SDL_free( imgs );
+}
+
+
+int main( int argc, char *argv[] ){
+
+	struct { const char *name; int w, h; } sizes [] = {
+		{ "8k",   7680,  4320 },
+		{ "16k", 15360,  8640 },
+		{ "32k", 30720, 17280 }
+	};
+
+	select_blur_kernels( BLUR_AVX2 );
+	POOL = create_worker_pool( SDL_GetNumLogicalCPUCores() );
+
+	for (int s = 0; s < SDL_arraysize( sizes ); ++s ){
+		bool run = argc < 2;
+		for (int a = 1; a < argc; ++a ){
+			if( SDL_strcasecmp( argv[a], sizes[s].name ) == 0 ) run = true;
+		}
+		if( run ) bench_scale_n_blur( sizes[s].name, sizes[s].w, sizes[s].h );
+	}
+
+	struct { const char *name; int n; } packs [] = {
+		{ "pack1k",  1000 },
+		{ "pack10k", 10000 }
+	};
+	width = 1920;
+	height = 1080;
+	for (int p = 0; p < SDL_arraysize( packs ); ++p ){
+		bool run = argc < 2;
+		for (int a = 1; a < argc; ++a ){
+			if( SDL_strcasecmp( argv[a], packs[p].name ) == 0 ) run = true;
+		}
+		if( run ) bench_packing( packs[p].name, packs[p].n );
+	}
+
+	destroy_worker_pool( POOL );
+	POOL = NULL;
+
+	return 0;
+}
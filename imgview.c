@@ -1,3 +1,6 @@
+#ifdef __linux__
+#define _DEFAULT_SOURCE// for readdir's DT_ types under -std=c11
+#endif
 #include <SDL.h>
 #include <SDL_image.h>
 #include "ok_lib.h"
@@ -8,6 +11,19 @@
 
 #include <windows.h>
 
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+
+#ifdef USE_LIBJPEG
+#include <stdio.h>
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+
 SDL_Renderer *R;
 SDL_Window *window;
 int width = 500, height = 500;// of the window
@@ -23,12 +39,49 @@ typedef struct ok_vec_of(const char *) str_vec;
 
 
 
-void destroy_str_vec( str_vec *v ){
+/* Bump allocator for lots of little strings that all go away together, like a folder listing.
+   Chunks are only ever added on, never realloc'd, so the strings stay put. */
+#define ARENA_CHUNK ( 64 * 1024 )
+
+typedef struct str_chunk {
+	struct str_chunk *next;
+	size_t used, cap;
+	char data [];
+} Str_Chunk;
+
+typedef struct { Str_Chunk *head; } String_Arena;// zeroed is empty
+
+char *arena_alloc( String_Arena *A, size_t len ){
+	Str_Chunk *C = A->head;
+	if( C == NULL || C->used + len > C->cap ){
+		size_t cap = SDL_max( ARENA_CHUNK, len );
+		C = SDL_malloc( sizeof(Str_Chunk) + cap );
+		C->next = A->head;
+		C->used = 0;
+		C->cap = cap;
+		A->head = C;
+	}
+	char *str = C->data + C->used;
+	C->used += len;
+	return str;
+}
+
+// moves all of from's strings over to A
+void arena_adopt( String_Arena *A, String_Arena *from ){
+	if( from->head == NULL ) return;
+	Str_Chunk *last = from->head;
+	while( last->next ) last = last->next;
+	last->next = A->head;
+	A->head = from->head;
+	from->head = NULL;
+}
 
-	ok_vec_foreach_rev( v, char *str ) {
-		SDL_free( str );
+void arena_free( String_Arena *A ){
+	while( A->head ){
+		Str_Chunk *next = A->head->next;
+		SDL_free( A->head );
+		A->head = next;
 	}
-	ok_vec_deinit( v );
 }
 
 //reverse cmp
@@ -124,50 +177,16 @@ size_t cleanse_path( char *path ){
 char *folderpath = NULL;
 int folderpath_len = 0;
 int INDEX = 0;// of the present file in the list
+int listing_depth = 1;// what the list was scanned down to, a rescan keeps to it
 bool remote_operation = false;
 
 int antialiasing = SDL_SCALEMODE_LINEAR;
 bool fit = false;
 bool animating = false;
 int tasking = 0;
-bool enable_blur = true;
-float blur_zoom_threshhold = 0.18;
-
-
-
-SDL_EnumerationResult enudir_callback(void *userdata, const char *dirname, const char *fname){
+bool enable_mips = true;
 
-	char *name = fname;
-	size_t dl = SDL_strlen(dirname);
-	if( dl > folderpath_len ){
-		SDL_snprintf( buffer, bufflen, "%s%s", dirname + folderpath_len, fname );
-		name = buffer;
-	}
-	size_t len = SDL_strlen( name );
-	//SDL_Log(">buf:[%s]\n", name );
 
-	if( check_extension( fname ) ){
-		const char **neo = ok_vec_push_new( (str_vec*)userdata );
-		*neo = SDL_calloc( len+1, sizeof(char) );
-		SDL_memcpy( *neo, name, len+1 );
-	}
-	else{
-		char *path = name;
-		if( remote_operation ){
-			SDL_snprintf( buffer+512, 512, "%s%s", dirname, fname );
-			path = buffer+512;
-		}
-		SDL_PathInfo info = {0};
-		SDL_GetPathInfo( path, &info );
-		if( info.type == SDL_PATHTYPE_DIRECTORY ){
-			//SDL_Log("  found dir: [%s]", name );
-			const char **neo = ok_vec_push_new( (str_vec*)userdata );
-			*neo = SDL_calloc( len+2, sizeof(char) );
-			SDL_snprintf( *neo, len+2, "%s\\", name );
-		}
-	}
-	return SDL_ENUM_CONTINUE;
-}
 
 void shuffle_str_list( const char **deck, int len ){
 	for (int i = 0; i < len-2; ++i){
@@ -178,48 +197,6 @@ void shuffle_str_list( const char **deck, int len ){
 	}
 }
 
-void load_folderlist( str_vec *list, char *pfname, int depth ){
-
-	//SDL_Log("load_folderlist( %s, %d );\n", pfname, depth );
-
-	ok_vec_init( list );
-	if( !SDL_EnumerateDirectory( folderpath, enudir_callback, list ) ){
-		SDL_Log("SDL_EnumerateDirectory (1) error: %s", SDL_GetError());
-		SDL_Log(">{%s}", folderpath );
-	}
-	depth -= 1;
-	while( depth > 0 ){
-		//SDL_Log("looking for subfolders...");
-		int new_subdirs = 0;
-		ok_vec_foreach_rev( list, char *p ) {
-			size_t l = SDL_strlen(p);
-			if( p[l-1] == '\\' ){
-				//SDL_Log( "new subfolder: %s\n", p );
-				SDL_snprintf( buffer, bufflen, "%s%s", folderpath, p );
-				if( !SDL_EnumerateDirectory( buffer, enudir_callback, list ) ){
-					SDL_Log("SDL_EnumerateDirectory (2) error: %s", SDL_GetError());
-					SDL_Log(">{%s}", buffer );
-				}
-				ok_vec_remove( list, p );
-				SDL_free( p );
-				new_subdirs += 1;
-			}
-		}
-		if( new_subdirs <= 0 ) break;
-		depth -= 1;
-	}
-
-	// find where we are in the directory
-	for (int i = 0; i < ok_vec_count( list ); ++i){
-		if( strrcmp( pfname, ok_vec_get( list, i ) ) == 0 ){
-			INDEX = i;
-			break;
-		}
-	}
-}
-
-
-
 void regularize_surface( SDL_Surface **S, SDL_Surface *T ){
 
 	if( (*S)->format != T->format ){
@@ -282,589 +259,4000 @@ void fit_rect( SDL_FRect *A, SDL_Rect *B ){
 }
 
 
-void draw_corners( SDL_Renderer*R, SDL_FRect *DST, int w ){
-	// Top-left
-	SDL_RenderLine(R, DST->x, DST->y, DST->x + w, DST->y);  
-	SDL_RenderLine(R, DST->x, DST->y, DST->x, DST->y + w);  
-	// Top-right
-	SDL_RenderLine(R, DST->x + DST->w - 1 - w, DST->y, DST->x + DST->w - 1, DST->y);  
-	SDL_RenderLine(R, DST->x + DST->w - 1, DST->y, DST->x + DST->w - 1, DST->y + w);  
-	// Bottom-left
-	SDL_RenderLine(R, DST->x, DST->y + DST->h - 1, DST->x + w, DST->y + DST->h - 1);  
-	SDL_RenderLine(R, DST->x, DST->y + DST->h - 1 - w, DST->x, DST->y + DST->h - 1);  
-	// Bottom-right
-	SDL_RenderLine(R, DST->x + DST->w - 1 - w, DST->y + DST->h - 1, DST->x + DST->w - 1, DST->y + DST->h - 1);
-	SDL_RenderLine(R, DST->x + DST->w - 1, DST->y + DST->h - 1 - w, DST->x + DST->w - 1, DST->y + DST->h - 1);  
+/* Quads that go out together in one SDL_RenderGeometry. With texture NULL they're flat, in
+   their vertex color. Rotation is clockwise about the middle of dst, like SDL_RenderTextureRotated */
+typedef struct {
+	SDL_Texture *texture;
+	float tex_w, tex_h;
+	SDL_Vertex *verts;
+	int *indices;
+	int n, cap;// in quads
+} Quad_Batch;
+
+void batch_quad( Quad_Batch *B, const SDL_FRect *dst, const SDL_FRect *src, double angle, SDL_FlipMode flip, SDL_FColor color ){
+
+	if( B->n == B->cap ){
+		B->cap = SDL_max( 64, 2 * B->cap );
+		B->verts = SDL_realloc( B->verts, 4 * B->cap * sizeof(SDL_Vertex) );
+		B->indices = SDL_realloc( B->indices, 6 * B->cap * sizeof(int) );
+		for (int q = B->n; q < B->cap; ++q ){
+			int *I = B->indices + 6*q;
+			I[0] = 4*q; I[1] = 4*q + 1; I[2] = 4*q + 2;
+			I[3] = 4*q + 2; I[4] = 4*q + 3; I[5] = 4*q;
+		}
+	}
+	float u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+	if( B->texture ){
+		u0 = src->x / B->tex_w;  u1 = ( src->x + src->w ) / B->tex_w;
+		v0 = src->y / B->tex_h;  v1 = ( src->y + src->h ) / B->tex_h;
+		if( flip & SDL_FLIP_HORIZONTAL ){ float t = u0; u0 = u1; u1 = t; }
+		if( flip & SDL_FLIP_VERTICAL ){ float t = v0; v0 = v1; v1 = t; }
+	}
+	SDL_Vertex *V = B->verts + 4 * B->n++;
+	V[0] = (SDL_Vertex){ { dst->x,          dst->y          }, color, { u0, v0 } };
+	V[1] = (SDL_Vertex){ { dst->x + dst->w, dst->y          }, color, { u1, v0 } };
+	V[2] = (SDL_Vertex){ { dst->x + dst->w, dst->y + dst->h }, color, { u1, v1 } };
+	V[3] = (SDL_Vertex){ { dst->x,          dst->y + dst->h }, color, { u0, v1 } };
+	if( angle != 0 ){
+		float c = SDL_cos( angle * SDL_PI_D / 180 );
+		float s = SDL_sin( angle * SDL_PI_D / 180 );
+		float cx = dst->x + 0.5f * dst->w;
+		float cy = dst->y + 0.5f * dst->h;
+		for (int k = 0; k < 4; ++k ){
+			float x = V[k].position.x - cx, y = V[k].position.y - cy;
+			V[k].position = (SDL_FPoint){ cx + x*c - y*s, cy + x*s + y*c };
+		}
+	}
 }
 
+void flush_batch( Quad_Batch *B ){
+	if( B->n == 0 ) return;
+	SDL_RenderGeometry( R, B->texture, B->verts, 4 * B->n, B->indices, 6 * B->n );
+	B->n = 0;
+}
 
-// Gaussian function for weights
-static inline float gaussian(float x, float sigma) {
-    return SDL_expf(-(x * x) / (2.0f * sigma * sigma)) / (SDL_sqrtf(2 * SDL_PI_F) * sigma);
+void free_batch( Quad_Batch *B ){
+	SDL_free( B->verts );
+	SDL_free( B->indices );
+	B->verts = NULL;
+	B->indices = NULL;
+	B->n = B->cap = 0;
 }
 
-SDL_Surface* load_scale_n_blur( const char* filepath, int target_w, int target_h, float blur){
-    // Load image
-    SDL_Surface* original = IMG_Load(filepath);
-    if (!original) {
-        SDL_Log("Failed to load image: %s", SDL_GetError());
-        return NULL;
-    }
+// little L's at the corners of DST, as 8 thin quads. white is an all-white bit of B's texture
+void batch_corners( Quad_Batch *B, SDL_FRect *DST, int w, SDL_FColor color, const SDL_FRect *white ){
+	float r = DST->x + DST->w - 1;
+	float b = DST->y + DST->h - 1;
+	SDL_FRect bits [8] = {
+		{ DST->x, DST->y, w+1, 1 }, { DST->x, DST->y, 1, w+1 },// Top-left
+		{ r - w,  DST->y, w+1, 1 }, { r,      DST->y, 1, w+1 },// Top-right
+		{ DST->x, b,      w+1, 1 }, { DST->x, b - w,  1, w+1 },// Bottom-left
+		{ r - w,  b,      w+1, 1 }, { r,      b - w,  1, w+1 } // Bottom-right
+	};
+	for (int i = 0; i < 8; ++i ) batch_quad( B, bits + i, white, 0, SDL_FLIP_NONE, color );
+}
 
-    SDL_Surface* converted = SDL_ConvertSurface(original, SDL_PIXELFORMAT_RGBA32);
-    SDL_DestroySurface(original);
-    if (!converted) {
-        SDL_Log("Failed to convert surface: %s", SDL_GetError());
-        return NULL;
-    }
 
-    SDL_FRect crct = (SDL_FRect){0,0,converted->w, converted->h};
-    SDL_Rect trct = (SDL_Rect){0,0,target_w, target_h};
-    fit_rect( &crct, &trct );
-    target_w = crct.w;
-    target_h = crct.h;
+/* Persistent worker pool. Every worker owns a deque of jobs: it pops its own newest job first and,
+   when that runs dry, steals the oldest job from the other workers. Jobs submitted from outside
+   the pool are dealt round-robin, jobs submitted by a worker go on its own deque. */
+
+typedef void (*job_func)( void *data, int index );
+
+typedef struct job_group_struct{
+	SDL_AtomicInt pending;
+} Job_Group;
+
+typedef struct job_struct{
+	job_func func;
+	void *data;
+	int index;
+	Job_Group *group;
+} Job;
+
+typedef struct job_deque_struct{
+	SDL_Mutex *lock;
+	Job *jobs;
+	int head, count, cap;
+	struct worker_pool_struct *pool;// owner
+	int id;
+} Job_Deque;
+
+typedef struct worker_pool_struct{
+	int N;
+	SDL_Thread **threads;
+	Job_Deque *deques;
+	SDL_Semaphore *work;// one count per queued job
+	SDL_Mutex *lock;
+	SDL_Condition *finished;// broadcast whenever a group's last job is done
+	SDL_AtomicInt next;
+	SDL_AtomicInt quit;
+} Worker_Pool;
+
+Worker_Pool *POOL = NULL;
+
+static _Thread_local int pool_worker_id = -1;// which worker this thread is, -1 if none
+
+static void deque_push( Job_Deque *D, Job *J ){
+	SDL_LockMutex( D->lock );
+	if( D->count == D->cap ){
+		int ncap = D->cap? 2 * D->cap : 64;
+		Job *neo = SDL_malloc( ncap * sizeof(Job) );
+		for (int i = 0; i < D->count; ++i ){
+			neo[i] = D->jobs[ (D->head + i) % D->cap ];
+		}
+		SDL_free( D->jobs );
+		D->jobs = neo;
+		D->head = 0;
+		D->cap = ncap;
+	}
+	D->jobs[ (D->head + D->count) % D->cap ] = *J;
+	D->count += 1;
+	SDL_UnlockMutex( D->lock );
+}
 
-    // Create target surface
-    SDL_Surface* output = SDL_CreateSurface(target_w, target_h, converted->format);
-    if (!output) {
-        SDL_Log("Failed to create surface: %s", SDL_GetError());
-        SDL_DestroySurface(converted);
-        return NULL;
-    }
-    
-    float scale = (float)converted->w / target_w;
-    float sigma = scale * 0.5f;
-    int radius = SDL_ceilf(sigma * blur);
-    int lens_len = (2 * radius + 1) * (2 * radius + 1);
-    
-    float* lens = SDL_malloc( lens_len * sizeof(float) );
-    float sum = 0.0f;
-    
-    for (int y = -radius; y <= radius; y++) {
-        for (int x = -radius; x <= radius; x++) {
-            float dist = SDL_sqrtf(x*x + y*y);
-            float weight = gaussian(dist, sigma);
-            lens[(y + radius) * (2 * radius + 1) + (x + radius)] = weight;
-            sum += weight;
-        }
-    }
-    
-    // Normalize
-    sum = 1.0 / sum;
-    for (int i = 0; i < lens_len; i++) {
-        lens[i] *= sum;
-    }
+// back is the owner's end, front is where thieves take from
+static bool deque_pop( Job_Deque *D, Job *out, bool back ){
+	bool got = false;
+	SDL_LockMutex( D->lock );
+	if( D->count > 0 ){
+		if( back ){
+			*out = D->jobs[ (D->head + D->count - 1) % D->cap ];
+		} else {
+			*out = D->jobs[ D->head ];
+			D->head = (D->head + 1) % D->cap;
+		}
+		D->count -= 1;
+		got = true;
+	}
+	SDL_UnlockMutex( D->lock );
+	return got;
+}
 
-    SDL_PixelFormatDetails *deets = SDL_GetPixelFormatDetails(output->format);
+// only call after taking a count from P->work, so a job is guaranteed to be somewhere
+static void pool_take( Worker_Pool *P, Job *out ){
+	int me = pool_worker_id;
+	while( 1 ){
+		if( me >= 0 && deque_pop( P->deques + me, out, true ) ) return;
+		for (int i = 1; i <= P->N; ++i ){
+			int victim = (me + i + P->N) % P->N;
+			if( deque_pop( P->deques + victim, out, false ) ) return;
+		}
+	}
+}
 
-    SDL_LockSurface(converted);
-    SDL_LockSurface(output);
+// the group can go away as soon as pending hits 0, so it's not touched after that
+static void run_job( Worker_Pool *P, Job *J ){
+	J->func( J->data, J->index );
+	if( J->group && SDL_AddAtomicInt( &(J->group->pending), -1 ) == 1 ){
+		SDL_LockMutex( P->lock );
+		SDL_BroadcastCondition( P->finished );
+		SDL_UnlockMutex( P->lock );
+	}
+}
 
-    Uint32* src_pixels = (Uint32*)converted->pixels;
-    Uint32* dst_pixels = (Uint32*)output->pixels;
-
-    for (int dst_y = 0; dst_y < target_h; dst_y++) {
-        for (int dst_x = 0; dst_x < target_w; dst_x++) {
-            float src_center_x = dst_x * scale;
-            float src_center_y = dst_y * scale;
-            
-            float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
-            
-            for (int ky = -radius; ky <= radius; ky++) {
-                for (int kx = -radius; kx <= radius; kx++) {
-                    int src_x = (int)(src_center_x + kx);
-                    int src_y = (int)(src_center_y + ky);
-                    
-                    src_x = SDL_clamp(src_x, 0, converted->w - 1);
-                    src_y = SDL_clamp(src_y, 0, converted->h - 1);
-                    
-                    Uint32 pixel = src_pixels[src_y * converted->w + src_x];
-                    SDL_Color color;
-                    SDL_GetRGBA(pixel, deets, NULL, &color.r, &color.g, &color.b, &color.a);
-                    
-                    float weight = lens[(ky + radius) * (2 * radius + 1) + (kx + radius)];
-                    r += color.r * weight;
-                    g += color.g * weight;
-                    b += color.b * weight;
-                    a += color.a * weight;
-                }
-            }
-            
-            dst_pixels[dst_y * target_w + dst_x] = SDL_MapRGBA(
-                deets, NULL,
-                (uint8_t)SDL_clamp(r, 0.0f, 255.0f),
-                (uint8_t)SDL_clamp(g, 0.0f, 255.0f),
-                (uint8_t)SDL_clamp(b, 0.0f, 255.0f),
-                (uint8_t)SDL_clamp(a, 0.0f, 255.0f)
-            );
-        }
-    }
+static int pool_worker_thread( void *data ){
+	Job_Deque *mine = data;
+	Worker_Pool *P = mine->pool;
+	pool_worker_id = mine->id;
+	while( 1 ){
+		SDL_WaitSemaphore( P->work );
+		if( SDL_GetAtomicInt( &(P->quit) ) ) break;
+		Job J;
+		pool_take( P, &J );
+		run_job( P, &J );
+	}
+	return 0;
+}
 
-    SDL_UnlockSurface(converted);
-    SDL_UnlockSurface(output);
-    SDL_free(lens);
+Worker_Pool *create_worker_pool( int N ){
+	Worker_Pool *P = SDL_calloc( 1, sizeof(Worker_Pool) );
+	P->N = SDL_max( 1, N );
+	P->threads = SDL_calloc( P->N, sizeof(SDL_Thread*) );
+	P->deques = SDL_calloc( P->N, sizeof(Job_Deque) );
+	P->work = SDL_CreateSemaphore( 0 );
+	P->lock = SDL_CreateMutex();
+	P->finished = SDL_CreateCondition();
+	for (int i = 0; i < P->N; ++i ){
+		P->deques[i].lock = SDL_CreateMutex();
+		P->deques[i].pool = P;
+		P->deques[i].id = i;
+	}
+	for (int i = 0; i < P->N; ++i ){
+		P->threads[i] = SDL_CreateThread( pool_worker_thread, "worker", P->deques + i );
+	}
+	return P;
+}
 
-    // Cleanup
-    SDL_DestroySurface(converted);
+/* Jobs still queued are run on the calling thread once the workers are gone, so whatever they
+   hold gets handed back or freed the usual way. Cancel what's going on on it first, so they bail */
+void destroy_worker_pool( Worker_Pool *P ){
+	SDL_SetAtomicInt( &(P->quit), 1 );
+	for (int i = 0; i < P->N; ++i ) SDL_SignalSemaphore( P->work );
+	for (int i = 0; i < P->N; ++i ) SDL_WaitThread( P->threads[i], NULL );
+
+	// every worker took one count on its way out, what's left is one per job still queued.
+	// Standing in as a worker, jobs that wait on ones of their own get those run too
+	pool_worker_id = 0;
+	while( SDL_TryWaitSemaphore( P->work ) ){
+		Job J;
+		pool_take( P, &J );
+		run_job( P, &J );
+	}
+	pool_worker_id = -1;
+	for (int i = 0; i < P->N; ++i ){
+		SDL_DestroyMutex( P->deques[i].lock );
+		SDL_free( P->deques[i].jobs );
+	}
+	SDL_DestroySemaphore( P->work );
+	SDL_DestroyCondition( P->finished );
+	SDL_DestroyMutex( P->lock );
+	SDL_free( P->deques );
+	SDL_free( P->threads );
+	SDL_free( P );
+}
 
-    return output;
+// group may be NULL for fire-and-forget jobs
+void pool_submit( Worker_Pool *P, Job_Group *G, job_func func, void *data, int index ){
+	Job J = (Job){ func, data, index, G };
+	if( G ) SDL_AddAtomicInt( &(G->pending), 1 );
+	int d = pool_worker_id;
+	if( d < 0 || d >= P->N ) d = (unsigned) SDL_AddAtomicInt( &(P->next), 1 ) % P->N;
+	deque_push( P->deques + d, &J );
+	SDL_SignalSemaphore( P->work );
+}
+
+/* Blocks until every job in the group has run. Workers keep running other jobs while they wait,
+   so jobs may wait on groups of their own. Other threads just sleep. */
+void pool_wait( Worker_Pool *P, Job_Group *G ){
+	bool worker = pool_worker_id >= 0;
+	while( SDL_GetAtomicInt( &(G->pending) ) > 0 ){
+		if( worker && SDL_TryWaitSemaphore( P->work ) ){
+			Job J;
+			pool_take( P, &J );
+			run_job( P, &J );
+			continue;
+		}
+		SDL_LockMutex( P->lock );
+		if( SDL_GetAtomicInt( &(G->pending) ) > 0 ){
+			// workers look up every so often in case new jobs turned up to help with
+			SDL_WaitConditionTimeout( P->finished, P->lock, worker? 2 : -1 );
+		}
+		SDL_UnlockMutex( P->lock );
+	}
+}
+
+/* The main loop sleeps in SDL_WaitEventTimeout until there's something to do, so whatever hands
+   results back to it from another thread calls wake_main() afterwards. Wakes coalesce: there's
+   never more than one WAKE_EVENT in the queue, the main loop rearms it when it sees it. */
+Uint32 WAKE_EVENT = 0;
+SDL_AtomicInt wake_pending;
+
+void wake_main( void ){
+	if( WAKE_EVENT == 0 ) return;
+	if( SDL_CompareAndSwapAtomicInt( &wake_pending, 0, 1 ) ){
+		SDL_Event E;
+		SDL_zero( E );
+		E.type = WAKE_EVENT;
+		if( !SDL_PushEvent( &E ) ) SDL_SetAtomicInt( &wake_pending, 0 );
+	}
 }
 
 
+/* Folder listings. Every directory is a job on the worker pool, so the subfolders get read
+   side by side, each worker collecting what it finds in its own vector, merged at the end.
+   Entries are relative to folderpath, subfolders end in a backslash. */
 typedef struct {
-    SDL_Mutex* lock;
-    SDL_Thread* thread;
-    char filepath[1024];
-    int target_w, target_h;
-    float blur_factor;
-    SDL_Surface* output;
-    int progress;
-    int completed;
-    int cancel_requested;
-} BigImg_LSnB_Task;
+	Job_Group job;
+	str_vec *found;// per worker
+	String_Arena *strings;// per worker, holding found's strings
+	int N;
+	int max_depth;
+	SDL_AtomicInt files, dirs;
+	SDL_AtomicInt left;// directories still to be read
+	SDL_AtomicInt cancel;
+} Folder_Scan;
 
-int LSnB_thread(void* data) {
-    BigImg_LSnB_Task* task = (BigImg_LSnB_Task*)data;
-    
-    SDL_Surface* surf = load_scale_n_blur( task->filepath, 
-                                           task->target_w, task->target_h, 
-                                           task->blur_factor );
-    
-    SDL_LockMutex( task->lock );
-    if( task->cancel_requested ){
-    	if (surf) {
-	        SDL_DestroySurface(surf);
-	    }
-	}else{
-        task->output = surf;
-        task->completed = 1;
-    }
-    SDL_UnlockMutex( task->lock );
-    
-    return 0;
+typedef struct {
+	Folder_Scan *scan;
+	const char *rel;// "" for folderpath itself
+	int depth;// folderpath is 1
+} Scan_Dir;
+
+static _Thread_local String_Arena *scan_strings;// the current worker's
+
+static void push_entry( str_vec *list, const char *rel, const char *name, const char *tail ){
+	size_t len = SDL_strlen( rel ) + SDL_strlen( name ) + SDL_strlen( tail ) + 1;
+	const char **neo = ok_vec_push_new( list );
+	*neo = arena_alloc( scan_strings, len );
+	SDL_snprintf( (char*) *neo, len, "%s%s%s", rel, name, tail );
 }
 
-BigImg_LSnB_Task* launch_LSnB_thread( const char* filepath, int w, int h, float blur) {
-
-    BigImg_LSnB_Task* task = SDL_calloc( 1, sizeof(BigImg_LSnB_Task) );
-    *task = (BigImg_LSnB_Task){
-        .lock = SDL_CreateMutex(),
-        .target_w = w,
-        .target_h = h,
-        .blur_factor = blur
-    };
-    SDL_strlcpy(task->filepath, filepath, sizeof(task->filepath));
-    
-    task->thread = SDL_CreateThread( LSnB_thread, "load_scale_n_blur_big_image", task );
-    return task;
+#ifdef _WIN32
+// FindFirstFileEx hands over the attributes along with the names, so nothing needs a stat
+static void scan_directory( const char *rel, str_vec *found, str_vec *subdirs ){
+
+	char path [1024];
+	wchar_t wpath [1024];
+	SDL_snprintf( path, 1024, "%s%s*", folderpath, rel );
+	MultiByteToWideChar( CP_UTF8, 0, path, -1, wpath, 1024 );
+
+	WIN32_FIND_DATAW fd;
+	HANDLE h = FindFirstFileExW( wpath, FindExInfoBasic, &fd, FindExSearchNameMatch, NULL,
+	                             FIND_FIRST_EX_LARGE_FETCH );
+	if( h == INVALID_HANDLE_VALUE ){
+		SDL_Log( "couldn't list %s (%lu)", path, GetLastError() );
+		return;
+	}
+	do{
+		char name [1024];
+		WideCharToMultiByte( CP_UTF8, 0, fd.cFileName, -1, name, 1024, NULL, NULL );
+		if( fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ){
+			if( subdirs && SDL_strcmp( name, "." ) != 0 && SDL_strcmp( name, ".." ) != 0 ){
+				push_entry( subdirs, rel, name, "\\" );
+			}
+		}
+		else if( check_extension( name ) ){
+			push_entry( found, rel, name, "" );
+		}
+	} while( FindNextFileW( h, &fd ) );
+	FindClose( h );
+}
+#elif defined(__linux__)
+// readdir's d_type says what it is, only links and filesystems that don't fill it in need a stat
+static void scan_directory( const char *rel, str_vec *found, str_vec *subdirs ){
+
+	char path [1024];
+	SDL_snprintf( path, 1024, "%s%s", folderpath, rel );
+	DIR *dir = opendir( path );
+	if( dir == NULL ){
+		SDL_Log( "couldn't list %s", path );
+		return;
+	}
+	struct dirent *de;
+	while( ( de = readdir( dir ) ) ){
+		const char *name = de->d_name;
+		if( check_extension( (char*) name ) ){
+			push_entry( found, rel, name, "" );
+		}
+		else if( subdirs && SDL_strcmp( name, "." ) != 0 && SDL_strcmp( name, ".." ) != 0 ){
+			bool is_dir = de->d_type == DT_DIR;
+			if( de->d_type == DT_UNKNOWN || de->d_type == DT_LNK ){
+				char full [1024];
+				SDL_snprintf( full, 1024, "%s%s", path, name );
+				SDL_PathInfo info = {0};
+				is_dir = SDL_GetPathInfo( full, &info ) && info.type == SDL_PATHTYPE_DIRECTORY;
+			}
+			if( is_dir ) push_entry( subdirs, rel, name, "\\" );
+		}
+	}
+	closedir( dir );
 }
+#else
+typedef struct { const char *rel; str_vec *found, *subdirs; } Scan_Lists;
 
-SDL_Texture* check_LSnB_Task( SDL_Renderer *R, BigImg_LSnB_Task* task ){
-    SDL_LockMutex( task->lock );
-    SDL_Texture* result = NULL;
-    if (task->completed) {
-		result = SDL_CreateTextureFromSurface( R, task->output );
-		if (!result) {
-		    SDL_Log("Failed to create texture: %s", SDL_GetError());
-		}
-		SDL_DestroySurface( task->output );
-        task->output = NULL;
-        task->completed = 0;
-    }
-    SDL_UnlockMutex(task->lock);
-    return result;
+static SDL_EnumerationResult scan_callback( void *userdata, const char *dirname, const char *fname ){
+	Scan_Lists *L = userdata;
+	if( check_extension( (char*) fname ) ){
+		push_entry( L->found, L->rel, fname, "" );
+	}
+	else if( L->subdirs ){
+		char path [1024];
+		SDL_snprintf( path, 1024, "%s%s", dirname, fname );
+		SDL_PathInfo info = {0};
+		if( SDL_GetPathInfo( path, &info ) && info.type == SDL_PATHTYPE_DIRECTORY ){
+			push_entry( L->subdirs, L->rel, fname, "\\" );
+		}
+	}
+	return SDL_ENUM_CONTINUE;
 }
 
-void cancel_and_destroy_task( BigImg_LSnB_Task* task ){
-    SDL_LockMutex( task->lock );
-    task->cancel_requested = 1;
-    if( task->output ){
-        SDL_DestroySurface( task->output );
-        task->output = NULL;
-    }
-    SDL_UnlockMutex( task->lock );
-    
-    SDL_WaitThread( task->thread, NULL );
-    SDL_DestroyMutex( task->lock );
-    SDL_free( task );
+static void scan_directory( const char *rel, str_vec *found, str_vec *subdirs ){
+	char path [1024];
+	SDL_snprintf( path, 1024, "%s%s", folderpath, rel );
+	Scan_Lists L = { rel, found, subdirs };
+	if( !SDL_EnumerateDirectory( path, scan_callback, &L ) ){
+		SDL_Log( "SDL_EnumerateDirectory error: %s >{%s}", SDL_GetError(), path );
+	}
+}
+#endif
+
+static void scan_dir_job( void *data, int index ){
+	(void) index;
+
+	Scan_Dir *D = data;
+	Folder_Scan *S = D->scan;
+
+	if( !SDL_GetAtomicInt( &(S->cancel) ) ){
+		str_vec *found = S->found + pool_worker_id;
+		scan_strings = S->strings + pool_worker_id;
+		str_vec subdirs;
+		ok_vec_init( &subdirs );
+		int before = ok_vec_count( found );
+		scan_directory( D->rel, found, (D->depth < S->max_depth)? &subdirs : NULL );
+		SDL_AddAtomicInt( &(S->files), ok_vec_count( found ) - before );
+
+		ok_vec_foreach( &subdirs, const char *sub ){
+			Scan_Dir *C = SDL_malloc( sizeof(Scan_Dir) );
+			*C = (Scan_Dir){ S, sub, D->depth + 1 };
+			SDL_AddAtomicInt( &(S->dirs), 1 );
+			SDL_AddAtomicInt( &(S->left), 1 );
+			pool_submit( POOL, &(S->job), scan_dir_job, C, 0 );
+		}
+		ok_vec_deinit( &subdirs );
+	}
+	SDL_free( D );
+	if( SDL_AddAtomicInt( &(S->left), -1 ) == 1 ) wake_main();
 }
 
+// lists folderpath down to depth levels of subfolders (1 is just the folder) in the background
+Folder_Scan *start_folder_scan( int depth ){
+	Folder_Scan *S = SDL_calloc( 1, sizeof(Folder_Scan) );
+	S->N = POOL->N;
+	S->found = SDL_calloc( S->N, sizeof(str_vec) );
+	S->strings = SDL_calloc( S->N, sizeof(String_Arena) );
+	for (int i = 0; i < S->N; ++i ) ok_vec_init( S->found + i );
+	S->max_depth = depth;
+	SDL_SetAtomicInt( &(S->dirs), 1 );
+	SDL_SetAtomicInt( &(S->left), 1 );
+
+	Scan_Dir *D = SDL_malloc( sizeof(Scan_Dir) );
+	*D = (Scan_Dir){ S, "", 1 };
+	pool_submit( POOL, &(S->job), scan_dir_job, D, 0 );
+	return S;
+}
 
+// finish_folder_scan() still waits out the jobs themselves, there's nothing left of them by then
+bool folder_scan_done( Folder_Scan *S ){
+	return SDL_GetAtomicInt( &(S->left) ) == 0;
+}
 
-typedef struct image_struct{
+static int compare_entries( const void *a, const void *b ){
+	return SDL_strcasecmp( *(const char**) a, *(const char**) b );
+}
 
-	int type;
+typedef struct ok_map_of( const char *, int ) index_map;
 
-	union{
+// where each entry of list is, from `from` on
+void index_folderlist( index_map *where, str_vec *list, int from ){
+	for (int i = from; i < (int) ok_vec_count( list ); ++i ){
+		ok_map_put( where, ok_vec_get( list, i ), i );
+	}
+}
 
-		SDL_Texture *TEXTURE;
+// -1 if it's not in there
+int find_in_folderlist( index_map *where, const char *entry ){
+	int *i = ok_map_get_ptr( where, entry );
+	return i? *i : -1;
+}
 
-		struct {
-			SDL_Texture *ORIGINAL;
-			SDL_Texture *SCALEDnBLURRED;
-			BigImg_LSnB_Task *task;
-		} B;// Big image
+/* Waits the scan out if needed and merges what was found into list, sorted, with the strings
+   going into the `strings` arena and their positions into `where`.
+   INDEX is set to wherever the entry pfname turned up. With list NULL it's all just thrown away */
+void finish_folder_scan( Folder_Scan *S, str_vec *list, String_Arena *strings, index_map *where, char *pfname ){
 
-		struct {
-			SDL_Texture **TEXTURES;
-			int framecount;
-			int FRAME, NFRAME;
-			int *delays;
-		} A;// Animation
+	if( !list ) SDL_SetAtomicInt( &(S->cancel), 1 );
+	pool_wait( POOL, &(S->job) );
 
-	} U;
+	if( list ){
+		ok_vec_init( list );
+		for (int i = 0; i < S->N; ++i ){
+			ok_vec_push_all( list, S->found + i );
+		}
+		SDL_qsort( ok_vec_begin( list ), ok_vec_count( list ), sizeof(char*), compare_entries );
 
-	SDL_Rect RCT;
+		ok_map_init_with_capacity( where, ok_vec_count( list ) );
+		index_folderlist( where, list, 0 );
 
-} Image;
+		// find where we are in the directory
+		int i = find_in_folderlist( where, pfname );
+		if( i >= 0 ) INDEX = i;
+	}
+	for (int i = 0; i < S->N; ++i ){
+		ok_vec_deinit( S->found + i );
+		if( list ) arena_adopt( strings, S->strings + i );
+		else arena_free( S->strings + i );
+	}
+	SDL_free( S->found );
+	SDL_free( S->strings );
+	SDL_free( S );
+}
 
-enum image_type { INVALID = 0, SIMPLE, BIG, ANIMATION };
+void load_folderlist( str_vec *list, String_Arena *strings, index_map *where, char *pfname, int depth ){
+	finish_folder_scan( start_folder_scan( depth ), list, strings, where, pfname );
+}
 
-void process_animation( Image *img, IMG_Animation *ANIM ){
-	img->type = ANIMATION;
-	img->U.A.framecount = ANIM->count;
-	img->U.A.TEXTURES = SDL_malloc( img->U.A.framecount * sizeof( SDL_Texture* ) );
-	for (int f = 0; f < img->U.A.framecount; ++f ){
-		img->U.A.TEXTURES[f] = SDL_CreateTextureFromSurface( R, ANIM->frames[f] );
-	}
-	img->U.A.delays = SDL_malloc( img->U.A.framecount * sizeof( int ) );
-	SDL_memcpy( img->U.A.delays, ANIM->delays, img->U.A.framecount * sizeof( int ) );
-	img->U.A.FRAME = 0;
-	img->U.A.NFRAME = SDL_GetTicks() + ANIM->delays[0];
-	img->RCT = (SDL_Rect){ 0, 0, ANIM->w, ANIM->h };
+void free_folderlist( str_vec *list, String_Arena *strings, index_map *where ){
+	ok_vec_deinit( list );
+	arena_free( strings );
+	ok_map_deinit( where );
 }
 
-void animation_tick( Image *img ){
 
-	Uint64 now = SDL_GetTicks();
-	if( now >= img->U.A.NFRAME ){
-		img->U.A.FRAME = cycle( img->U.A.FRAME + 1, 0, img->U.A.framecount );
-		img->U.A.NFRAME = now + img->U.A.delays[ img->U.A.FRAME ];
+/* Keeps an eye on folderpath from a thread of its own, so files showing up, going away or
+   getting renamed make it into directory_list without an F5. The watcher only reports them,
+   through `changes`; apply_folder_changes() does the editing, on the main thread.
+   Only folderpath itself is watched, not its subfolders. */
+enum folder_change_kind { FOLDER_ADDED, FOLDER_REMOVED, FOLDER_RENAMED, FOLDER_RESCAN };
+
+typedef struct {
+	int kind;
+	char *name, *new_name;// relative to folderpath, SDL_malloc'd
+} Folder_Change;
+
+typedef struct ok_queue_of( Folder_Change ) change_queue;
+
+typedef struct {
+	SDL_Thread *thread;
+	SDL_AtomicInt quit;
+	change_queue changes;
+} Folder_Watcher;
+
+static void report_change( Folder_Watcher *W, int kind, const char *name, const char *new_name ){
+	bool was = name && check_extension( (char*) name );
+	bool is = new_name && check_extension( (char*) new_name );
+	if( kind == FOLDER_RENAMED && !( was && is ) ){// only one side of it is an image
+		if( was ) report_change( W, FOLDER_REMOVED, name, NULL );
+		if( is ) report_change( W, FOLDER_ADDED, new_name, NULL );
+		return;
 	}
+	if( ( kind == FOLDER_ADDED || kind == FOLDER_REMOVED ) && !was ) return;
+
+	Folder_Change C = { kind, name? SDL_strdup( name ) : NULL, new_name? SDL_strdup( new_name ) : NULL };
+	ok_queue_push( &(W->changes), C );
+	wake_main();
 }
 
-void destroy_Image( Image *img ){
-	switch( img->type ){
+#ifdef _WIN32
+static int watch_folder( void *data ){
 
-		case SIMPLE:
-			SDL_DestroyTexture( img->U.TEXTURE );
-			img->U.TEXTURE = NULL;
-			break;
+	Folder_Watcher *W = data;
+	wchar_t wpath [1024];
+	MultiByteToWideChar( CP_UTF8, 0, folderpath[0]? folderpath : ".", -1, wpath, 1024 );
 
-		case BIG:
-			SDL_DestroyTexture( img->U.B.ORIGINAL );
-			SDL_DestroyTexture( img->U.B.SCALEDnBLURRED );
-			if( img->U.B.task ){
-				cancel_and_destroy_task( img->U.B.task );
+	HANDLE dir = CreateFileW( wpath, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+	                          NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL );
+	if( dir == INVALID_HANDLE_VALUE ){
+		SDL_Log( "can't watch %s (%lu)", folderpath, GetLastError() );
+		return 0;
+	}
+	OVERLAPPED ov = {0};
+	ov.hEvent = CreateEventW( NULL, FALSE, FALSE, NULL );
+	DWORD buf [ 16 * 1024 ];// DWORD aligned, as it needs to be
+	char name [1024], old_name [1024] = "";
+
+	while( !SDL_GetAtomicInt( &(W->quit) ) ){
+		if( !ReadDirectoryChangesW( dir, buf, sizeof(buf), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME, NULL, &ov, NULL ) ) break;
+
+		DWORD got = 0;
+		while( WaitForSingleObject( ov.hEvent, 250 ) == WAIT_TIMEOUT ){
+			if( SDL_GetAtomicInt( &(W->quit) ) ){
+				CancelIo( dir );
+				GetOverlappedResult( dir, &ov, &got, TRUE );
+				goto done;
 			}
-			break;
-
-		case ANIMATION:
-			for (int f = 0; f < img->U.A.framecount; ++f ){
-				SDL_DestroyTexture( img->U.A.TEXTURES[f] );
-				img->U.A.TEXTURES[f] = NULL;
+		}
+		if( !GetOverlappedResult( dir, &ov, &got, FALSE ) ) break;
+		if( got == 0 ){// more happened than fit in buf
+			report_change( W, FOLDER_RESCAN, NULL, NULL );
+			continue;
+		}
+		for( FILE_NOTIFY_INFORMATION *FNI = (FILE_NOTIFY_INFORMATION*) buf; ;
+		     FNI = (FILE_NOTIFY_INFORMATION*)( (char*) FNI + FNI->NextEntryOffset ) ){
+
+			int len = WideCharToMultiByte( CP_UTF8, 0, FNI->FileName, FNI->FileNameLength / sizeof(WCHAR),
+			                               name, 1023, NULL, NULL );
+			name[ len ] = '\0';
+			switch( FNI->Action ){
+				case FILE_ACTION_ADDED:            report_change( W, FOLDER_ADDED, name, NULL ); break;
+				case FILE_ACTION_REMOVED:          report_change( W, FOLDER_REMOVED, name, NULL ); break;
+				case FILE_ACTION_RENAMED_OLD_NAME: SDL_strlcpy( old_name, name, 1024 ); break;
+				case FILE_ACTION_RENAMED_NEW_NAME: report_change( W, FOLDER_RENAMED, old_name, name ); break;
 			}
-			SDL_free( img->U.A.TEXTURES );
-			img->U.A.TEXTURES = NULL;
-			SDL_free( img->U.A.delays );
-			img->U.A.delays = NULL;
-			break;
+			if( FNI->NextEntryOffset == 0 ) break;
+		}
 	}
-	img->type = INVALID;
+	done:
+	CloseHandle( ov.hEvent );
+	CloseHandle( dir );
+	return 0;
 }
+#elif defined(__linux__)
+static int watch_folder( void *data ){
+
+	Folder_Watcher *W = data;
+	int fd = inotify_init1( IN_CLOEXEC );
+	// a file counts as added once it's been written out, not when it's first created
+	if( fd < 0 || inotify_add_watch( fd, folderpath[0]? folderpath : ".",
+	                                 IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM ) < 0 ){
+		SDL_Log( "can't watch %s", folderpath );
+		if( fd >= 0 ) close( fd );
+		return 0;
+	}
+	char buf [ 64 * 1024 ] __attribute__(( aligned( __alignof__( struct inotify_event ) ) ));
+
+	while( !SDL_GetAtomicInt( &(W->quit) ) ){
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		if( poll( &pfd, 1, 250 ) <= 0 ) continue;
+		ssize_t got = read( fd, buf, sizeof(buf) );
+		if( got <= 0 ) break;
+
+		// a rename is a MOVED_FROM and a MOVED_TO with the same cookie, normally right after each other
+		const struct inotify_event *from = NULL;
+		for( char *p = buf; p < buf + got; ){
+			const struct inotify_event *E = (const struct inotify_event*) p;
+			p += sizeof(struct inotify_event) + E->len;
+
+			if( E->mask & IN_Q_OVERFLOW ){
+				report_change( W, FOLDER_RESCAN, NULL, NULL );
+				continue;
+			}
+			if( from && !( (E->mask & IN_MOVED_TO) && E->cookie == from->cookie ) ){
+				report_change( W, FOLDER_REMOVED, from->name, NULL );
+				from = NULL;
+			}
+			if( E->len == 0 || (E->mask & IN_ISDIR) ) continue;
 
-/* modes:
-0 - if it fits, centralize, else force-fit
-1 - centralize
-2 - force fit
-*/
-void calc_transform( Transform *T, SDL_Rect *RCT, int mode ){
+			if( E->mask & IN_MOVED_FROM ) from = E;
+			else if( E->mask & IN_MOVED_TO ){
+				if( from ) report_change( W, FOLDER_RENAMED, from->name, E->name );
+				else report_change( W, FOLDER_ADDED, E->name, NULL );
+				from = NULL;
+			}
+			else if( E->mask & IN_CLOSE_WRITE ) report_change( W, FOLDER_ADDED, E->name, NULL );
+			else if( E->mask & IN_DELETE ) report_change( W, FOLDER_REMOVED, E->name, NULL );
+		}
+		if( from ) report_change( W, FOLDER_REMOVED, from->name, NULL );
+	}
+	close( fd );
+	return 0;
+}
+#else
+static int watch_folder( void *data ){ return 0; }// nothing to watch with
+#endif
+
+Folder_Watcher *start_folder_watcher(){
+	Folder_Watcher *W = SDL_calloc( 1, sizeof(Folder_Watcher) );
+	ok_queue_init( &(W->changes) );
+	W->thread = SDL_CreateThread( watch_folder, "folder watcher", W );
+	return W;
+}
 
-	if( mode == 1 || ( mode == 0 && (RCT->w < width && RCT->h < height)) ){// CENTRALIZE IT 
-		T->tx = 0.5 * (width  - RCT->w);
-		T->ty = 0.5 * (height - RCT->h);
-		T->scale_i = 0;
-		T->scale = 1;
+void stop_folder_watcher( Folder_Watcher *W ){
+	SDL_SetAtomicInt( &(W->quit), 1 );
+	SDL_WaitThread( W->thread, NULL );
+	Folder_Change C;
+	while( ok_queue_pop( &(W->changes), &C ) ){
+		SDL_free( C.name );
+		SDL_free( C.new_name );
 	}
-	else{//                               DOESN'T FIT... FIT IT!
-		SDL_FRect DST = (SDL_FRect){ RCT->x, RCT->y, RCT->w, RCT->h };
-		fit_rect( &DST, &window_rect );
-		T->tx = DST.x; T->ty = DST.y;
-		T->scale = DST.w / (float) RCT->w;
-		T->scale_i = logarithm( 1.1, T->scale );
-		fit = 1;
+	ok_queue_deinit( &(W->changes) );
+	SDL_free( W );
+}
+
+// where entry would go in the sorted listing. In a shuffled one that's as good as anywhere
+static int folderlist_slot( str_vec *list, const char *entry ){
+	int lo = 0, hi = ok_vec_count( list );
+	while( lo < hi ){
+		int mid = (lo + hi) / 2;
+		if( compare_entries( &entry, ok_vec_get_ptr( list, mid ) ) > 0 ) lo = mid + 1;
+		else hi = mid;
 	}
+	return lo;
 }
 
+static void folderlist_insert( str_vec *list, String_Arena *strings, index_map *where, const char *name ){
+	size_t len = SDL_strlen( name ) + 1;
+	char *entry = arena_alloc( strings, len );
+	SDL_memcpy( entry, name, len );
+	int i = folderlist_slot( list, entry );
+	// not ok_vec_insert_at(), it drops the last element
+	ok_vec_push( list, entry );
+	const char **v = ok_vec_begin( list );
+	SDL_memmove( v + i + 1, v + i, ( ok_vec_count( list ) - 1 - i ) * sizeof(char*) );
+	v[i] = entry;
+	index_folderlist( where, list, i );
+	if( i <= INDEX && ok_vec_count( list ) > 1 ) INDEX += 1;
+}
 
-bool intersecting_or_touching( SDL_Rect *A, SDL_Rect *B ){
-	return ( ( A->x + A->w >= B->x ) && ( B->x + B->w >= A->x ) ) && 
-	       ( ( A->y + A->h >= B->y ) && ( B->y + B->h >= A->y ) );
+static int folderlist_remove( str_vec *list, index_map *where, const char *name ){
+	int i = find_in_folderlist( where, name );
+	if( i < 0 ) return -1;
+	ok_map_remove( where, name );
+	ok_vec_remove_at( list, i );
+	index_folderlist( where, list, i );
+	if( i < INDEX ) INDEX -= 1;
+	return i;
 }
 
-typedef struct i2d_struct{ int i, j; } i2d;
+enum folder_delta { FOLDER_UNCHANGED = 0, FOLDER_CHANGED, FOLDER_LOST_CURRENT };
+
+/* Brings the listing up to date with whatever the watcher saw, keeping INDEX on the same file.
+   If that file itself went away INDEX is left on the one that took its place,
+   and it returns FOLDER_LOST_CURRENT */
+int apply_folder_changes( Folder_Watcher *W, str_vec *list, String_Arena *strings, index_map *where ){
+
+	bool changed = 0, lost = 0;
+	Folder_Change C;
+	while( ok_queue_pop( &(W->changes), &C ) ){
+		switch( C.kind ){
+			case FOLDER_ADDED:
+				if( find_in_folderlist( where, C.name ) < 0 ){
+					folderlist_insert( list, strings, where, C.name );
+					changed = 1;
+				}
+				break;
+			case FOLDER_REMOVED:{
+				int prev = INDEX;
+				int i = folderlist_remove( list, where, C.name );
+				if( i >= 0 ) changed = 1;
+				if( i == prev ) lost = 1;
+				} break;
+			case FOLDER_RENAMED:{
+				bool current = find_in_folderlist( where, C.name ) == INDEX;
+				folderlist_remove( list, where, C.name );
+				if( find_in_folderlist( where, C.new_name ) < 0 ){
+					folderlist_insert( list, strings, where, C.new_name );
+				}
+				if( current ) INDEX = find_in_folderlist( where, C.new_name );
+				changed = 1;
+				} break;
+			case FOLDER_RESCAN:
+				if( ok_vec_count( list ) > 0 ){
+					char pfname [512];
+					SDL_strlcpy( pfname, ok_vec_get( list, INDEX ), 512 );
+					free_folderlist( list, strings, where );
+					load_folderlist( list, strings, where, pfname, listing_depth );
+					if( find_in_folderlist( where, pfname ) < 0 ) lost = 1;
+					changed = 1;
+				}
+				break;
+		}
+		SDL_free( C.name );
+		SDL_free( C.new_name );
+	}
+	if( INDEX >= (int) ok_vec_count( list ) ) INDEX = SDL_max( 0, (int) ok_vec_count( list ) - 1 );
+	return lost? FOLDER_LOST_CURRENT : changed;
+}
 
-// returns the total dimensions
-i2d pack_imgs( Image *imgs, int len ){
 
-	#define rects(i) imgs[i].RCT
+// Gaussian function for weights
+static inline float gaussian(float x, float sigma) {
+    return SDL_expf(-(x * x) / (2.0f * sigma * sigma)) / (SDL_sqrtf(2 * SDL_PI_F) * sigma);
+}
+
+/* The gaussian is separable, so scale_n_blur() runs it as a horizontal pass into a small ring of
+   float rows, then a vertical pass over that ring. Both work directly on RGBA32 bytes, and the
+   SSE2/AVX2 variants are picked at runtime by select_blur_kernels(). */
+
+// one source row -> tw RGBA float pixels, centered on x0[0..tw)
+typedef void (*blur_hpass_func)( const Uint8 *row, int w, const int *x0, int tw,
+                                 const float *lens, int radius, float *out );
+// floats [from, n) of the taps rows -> bytes
+typedef void (*blur_vpass_func)( const float **rows, const float *lens, int taps,
+                                 int from, int n, Uint8 *dst );
+
+static void blur_hpass_scalar( const Uint8 *row, int w, const int *x0, int tw,
+                               const float *lens, int radius, float *out ){
+	for (int dx = 0; dx < tw; ++dx ){
+		float r = 0, g = 0, b = 0, a = 0;
+		for (int k = -radius; k <= radius; ++k ){
+			const Uint8 *p = row + 4 * SDL_clamp( x0[dx] + k, 0, w-1 );
+			float wt = lens[ k + radius ];
+			r += p[0] * wt;
+			g += p[1] * wt;
+			b += p[2] * wt;
+			a += p[3] * wt;
+		}
+		out[4*dx+0] = r;
+		out[4*dx+1] = g;
+		out[4*dx+2] = b;
+		out[4*dx+3] = a;
+	}
+}
 
-	int *ids = SDL_malloc( len * sizeof(int) );
-	for(int i = 0; i < len; i++) ids[i] = i;
+static void blur_vpass_scalar( const float **rows, const float *lens, int taps,
+                               int from, int n, Uint8 *dst ){
+	for (int i = from; i < n; ++i ){
+		float v = 0;
+		for (int k = 0; k < taps; ++k ) v += rows[k][i] * lens[k];
+		dst[i] = (Uint8) SDL_clamp( v + 0.5f, 0.0f, 255.0f );
+	}
+}
 
-	float targetAR = width / (float)height;
+#ifdef SDL_SSE2_INTRINSICS
+static void blur_hpass_sse2( const Uint8 *row, int w, const int *x0, int tw,
+                             const float *lens, int radius, float *out ){
+	const __m128i zero = _mm_setzero_si128();
+	int taps = 2*radius + 1;
+	for (int dx = 0; dx < tw; ++dx ){
+		// taps go in pairs, so the last pair may read one pixel past x0+radius
+		if( x0[dx] - radius < 0 || x0[dx] + radius + 1 >= w ){
+			blur_hpass_scalar( row, w, x0 + dx, 1, lens, radius, out + 4*dx );
+			continue;
+		}
+		const Uint8 *p = row + 4 * (x0[dx] - radius);
+		__m128 acc0 = _mm_setzero_ps(), acc1 = acc0;
+		for (int k = 0; k < taps; k += 2 ){
+			__m128i px = _mm_unpacklo_epi8( _mm_loadl_epi64( (const __m128i*)(p + 4*k) ), zero );
+			__m128 w1 = _mm_set1_ps( ( k+1 < taps )? lens[k+1] : 0 );
+			acc0 = _mm_add_ps( acc0, _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( px, zero ) ),
+			                                     _mm_set1_ps( lens[k] ) ) );
+			acc1 = _mm_add_ps( acc1, _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( px, zero ) ), w1 ) );
+		}
+		_mm_storeu_ps( out + 4*dx, _mm_add_ps( acc0, acc1 ) );
+	}
+}
+
+static void blur_vpass_sse2( const float **rows, const float *lens, int taps,
+                             int from, int n, Uint8 *dst ){
+	const __m128 half = _mm_set1_ps( 0.5f );
+	int i = from;
+	for (; i + 16 <= n; i += 16 ){// 4 pixels at a time
+		__m128 a0 = _mm_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+		for (int k = 0; k < taps; ++k ){
+			__m128 wt = _mm_set1_ps( lens[k] );
+			const float *r = rows[k] + i;
+			a0 = _mm_add_ps( a0, _mm_mul_ps( _mm_loadu_ps( r +  0 ), wt ) );
+			a1 = _mm_add_ps( a1, _mm_mul_ps( _mm_loadu_ps( r +  4 ), wt ) );
+			a2 = _mm_add_ps( a2, _mm_mul_ps( _mm_loadu_ps( r +  8 ), wt ) );
+			a3 = _mm_add_ps( a3, _mm_mul_ps( _mm_loadu_ps( r + 12 ), wt ) );
+		}
+		__m128i lo = _mm_packs_epi32( _mm_cvttps_epi32( _mm_add_ps( a0, half ) ),
+		                              _mm_cvttps_epi32( _mm_add_ps( a1, half ) ) );
+		__m128i hi = _mm_packs_epi32( _mm_cvttps_epi32( _mm_add_ps( a2, half ) ),
+		                              _mm_cvttps_epi32( _mm_add_ps( a3, half ) ) );
+		_mm_storeu_si128( (__m128i*)(dst + i), _mm_packus_epi16( lo, hi ) );
+	}
+	blur_vpass_scalar( rows, lens, taps, i, n, dst );
+}
+#endif
+
+#ifdef SDL_AVX2_INTRINSICS
+SDL_TARGETING("avx2") static void blur_hpass_avx2( const Uint8 *row, int w, const int *x0, int tw,
+                                                   const float *lens, int radius, float *out ){
+	int taps = 2*radius + 1;
+	for (int dx = 0; dx < tw; ++dx ){
+		// taps go in pairs, so the last pair may read one pixel past x0+radius
+		if( x0[dx] - radius < 0 || x0[dx] + radius + 1 >= w ){
+			blur_hpass_scalar( row, w, x0 + dx, 1, lens, radius, out + 4*dx );
+			continue;
+		}
+		const Uint8 *p = row + 4 * (x0[dx] - radius);
+		__m256 acc = _mm256_setzero_ps();
+		for (int k = 0; k < taps; k += 2 ){
+			float w1 = ( k+1 < taps )? lens[k+1] : 0;
+			__m256 wt = _mm256_setr_ps( lens[k], lens[k], lens[k], lens[k], w1, w1, w1, w1 );
+			__m256i px = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)(p + 4*k) ) );
+			acc = _mm256_add_ps( acc, _mm256_mul_ps( _mm256_cvtepi32_ps( px ), wt ) );
+		}
+		_mm_storeu_ps( out + 4*dx, _mm_add_ps( _mm256_castps256_ps128( acc ),
+		                                       _mm256_extractf128_ps( acc, 1 ) ) );
+	}
+}
+
+SDL_TARGETING("avx2") static void blur_vpass_avx2( const float **rows, const float *lens, int taps,
+                                                   int from, int n, Uint8 *dst ){
+	const __m256 half = _mm256_set1_ps( 0.5f );
+	// packs/packus work within 128-bit lanes, this puts the 8 pixels back in order
+	const __m256i order = _mm256_setr_epi32( 0, 4, 1, 5, 2, 6, 3, 7 );
+	int i = from;
+	for (; i + 32 <= n; i += 32 ){// 8 pixels at a time
+		__m256 a0 = _mm256_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+		for (int k = 0; k < taps; ++k ){
+			__m256 wt = _mm256_set1_ps( lens[k] );
+			const float *r = rows[k] + i;
+			a0 = _mm256_add_ps( a0, _mm256_mul_ps( _mm256_loadu_ps( r +  0 ), wt ) );
+			a1 = _mm256_add_ps( a1, _mm256_mul_ps( _mm256_loadu_ps( r +  8 ), wt ) );
+			a2 = _mm256_add_ps( a2, _mm256_mul_ps( _mm256_loadu_ps( r + 16 ), wt ) );
+			a3 = _mm256_add_ps( a3, _mm256_mul_ps( _mm256_loadu_ps( r + 24 ), wt ) );
+		}
+		__m256i lo = _mm256_packs_epi32( _mm256_cvttps_epi32( _mm256_add_ps( a0, half ) ),
+		                                 _mm256_cvttps_epi32( _mm256_add_ps( a1, half ) ) );
+		__m256i hi = _mm256_packs_epi32( _mm256_cvttps_epi32( _mm256_add_ps( a2, half ) ),
+		                                 _mm256_cvttps_epi32( _mm256_add_ps( a3, half ) ) );
+		__m256i px = _mm256_permutevar8x32_epi32( _mm256_packus_epi16( lo, hi ), order );
+		_mm256_storeu_si256( (__m256i*)(dst + i), px );
+	}
+	blur_vpass_scalar( rows, lens, taps, i, n, dst );
+}
+#endif
+
+enum blur_kernel_level { BLUR_SCALAR = 0, BLUR_SSE2, BLUR_AVX2 };
+
+blur_hpass_func blur_hpass = blur_hpass_scalar;
+blur_vpass_func blur_vpass = blur_vpass_scalar;
+
+// picks the best kernels this CPU supports, up to max_level. returns the level picked
+int select_blur_kernels( int max_level ){
+	int level = BLUR_SCALAR;
+	blur_hpass = blur_hpass_scalar;
+	blur_vpass = blur_vpass_scalar;
+#ifdef SDL_SSE2_INTRINSICS
+	if( max_level >= BLUR_SSE2 && SDL_HasSSE2() ){
+		blur_hpass = blur_hpass_sse2;
+		blur_vpass = blur_vpass_sse2;
+		level = BLUR_SSE2;
+	}
+#endif
+#ifdef SDL_AVX2_INTRINSICS
+	if( max_level >= BLUR_AVX2 && SDL_HasAVX2() ){
+		blur_hpass = blur_hpass_avx2;
+		blur_vpass = blur_vpass_avx2;
+		level = BLUR_AVX2;
+	}
+#endif
+	return level;
+}
+
+typedef struct {
+    SDL_Surface *src, *output;
+    float scale;
+    int radius, taps;
+    float *lens;
+    int *x0;
+    int band_h;
+    SDL_AtomicInt *cancel;
+} Scale_n_Blur_Job;
+
+// one band of output rows. each band keeps its own ring of horizontally blurred rows
+static void scale_n_blur_band( void *data, int band ){
+    Scale_n_Blur_Job *J = data;
+    if( J->cancel && SDL_GetAtomicInt( J->cancel ) ) return;
+
+    SDL_Surface *src = J->src;
+    int taps = J->taps;
+    int target_w = J->output->w;
+    int y_begin = band * J->band_h;
+    int y_end = SDL_min( y_begin + J->band_h, J->output->h );
+
+    // slot = source row % taps
+    int ring_pitch = 4 * target_w;
+    float *ring = SDL_malloc( taps * ring_pitch * sizeof(float) );
+    int *ring_y = SDL_malloc( taps * sizeof(int) );
+    const float **rows = SDL_malloc( taps * sizeof(float*) );
+    for (int k = 0; k < taps; k++) ring_y[k] = -1;
+
+    for (int dst_y = y_begin; dst_y < y_end; dst_y++) {
+        int y0 = dst_y * J->scale;
+        for (int k = 0; k < taps; k++) {
+            int sy = SDL_clamp( y0 + k - J->radius, 0, src->h - 1 );
+            int slot = sy % taps;
+            float *row = ring + slot * ring_pitch;
+            if( ring_y[slot] != sy ){
+                blur_hpass( (Uint8*)src->pixels + (size_t) sy * src->pitch, src->w, J->x0, target_w,
+                            J->lens, J->radius, row );
+                ring_y[slot] = sy;
+            }
+            rows[k] = row;
+        }
+        blur_vpass( rows, J->lens, taps, 0, ring_pitch,
+                    (Uint8*)J->output->pixels + (size_t) dst_y * J->output->pitch );
+    }
+
+    SDL_free(rows);
+    SDL_free(ring_y);
+    SDL_free(ring);
+}
+
+/* downscales an RGBA32 surface to fit in target_w x target_h, gaussian-filtering it on the way.
+   The output rows are split in bands over POOL, if there is one.
+   Returns NULL if cancel gets set before it's done. */
+SDL_Surface* scale_n_blur( SDL_Surface *src, int target_w, int target_h, float blur, SDL_AtomicInt *cancel ){
+
+    SDL_FRect crct = (SDL_FRect){0,0,src->w, src->h};
+    SDL_Rect trct = (SDL_Rect){0,0,target_w, target_h};
+    fit_rect( &crct, &trct );
+    target_w = SDL_max( 1, crct.w );
+    target_h = SDL_max( 1, crct.h );
+
+    SDL_Surface* output = SDL_CreateSurface(target_w, target_h, SDL_PIXELFORMAT_RGBA32);
+    if (!output) {
+        SDL_Log("Failed to create surface: %s", SDL_GetError());
+        return NULL;
+    }
+
+    Scale_n_Blur_Job J = { .src = src, .output = output, .cancel = cancel };
+    J.scale = (float)src->w / target_w;
+    float sigma = J.scale * 0.5f;
+    J.radius = SDL_ceilf(sigma * blur);
+    J.taps = 2 * J.radius + 1;
+
+    J.lens = SDL_malloc( J.taps * sizeof(float) );
+    float sum = 0.0f;
+    for (int k = -J.radius; k <= J.radius; k++) {
+        J.lens[k + J.radius] = gaussian(k, sigma);
+        sum += J.lens[k + J.radius];
+    }
+    sum = 1.0 / sum;
+    for (int k = 0; k < J.taps; k++) J.lens[k] *= sum;
+
+    // source column under each destination column
+    J.x0 = SDL_malloc( target_w * sizeof(int) );
+    for (int dx = 0; dx < target_w; dx++) J.x0[dx] = dx * J.scale;
+
+    SDL_LockSurface(src);
+    SDL_LockSurface(output);
+
+    // a few bands per worker so they even out, but not so thin that the ring refills dominate
+    int bands = POOL? 4 * POOL->N : 1;
+    J.band_h = SDL_max( 2 * J.taps / SDL_max( 1, (int)J.scale ), (target_h + bands-1) / bands );
+    bands = (target_h + J.band_h-1) / J.band_h;
+
+    if( POOL && bands > 1 ){
+        Job_Group G = {0};
+        for (int b = 0; b < bands; b++) {
+            pool_submit( POOL, &G, scale_n_blur_band, &J, b );
+        }
+        pool_wait( POOL, &G );
+    }
+    else{
+        for (int b = 0; b < bands; b++) scale_n_blur_band( &J, b );
+    }
+
+    SDL_UnlockSurface(src);
+    SDL_UnlockSurface(output);
+
+    SDL_free(J.x0);
+    SDL_free(J.lens);
+
+    if( cancel && SDL_GetAtomicInt( cancel ) ){
+        SDL_DestroySurface( output );
+        return NULL;
+    }
+    return output;
+}
+
+typedef struct {
+    SDL_Surface *src, *dst;
+    int band_h;
+    SDL_AtomicInt *cancel;
+} Halve_Job;
+
+static void halve_band( void *data, int band ){
+    Halve_Job *J = data;
+    if( J->cancel && SDL_GetAtomicInt( J->cancel ) ) return;
+
+    SDL_Surface *src = J->src;
+    int y_end = SDL_min( (band+1) * J->band_h, J->dst->h );
+    for (int y = band * J->band_h; y < y_end; y++) {
+        const Uint8 *r0 = (Uint8*)src->pixels + (size_t) (2*y) * src->pitch;
+        const Uint8 *r1 = (Uint8*)src->pixels + (size_t) SDL_min( 2*y+1, src->h-1 ) * src->pitch;
+        Uint8 *out = (Uint8*)J->dst->pixels + (size_t) y * J->dst->pitch;
+        for (int x = 0; x < J->dst->w; x++) {
+            int a = 8*x;
+            int b = 4 * SDL_min( 2*x+1, src->w-1 );
+            for (int c = 0; c < 4; c++) {
+                out[4*x+c] = ( r0[a+c] + r0[b+c] + r1[a+c] + r1[b+c] + 2 ) >> 2;
+            }
+        }
+    }
+}
+
+// 2x2 box filter, RGBA32 in and out. odd edges get their last row/column doubled up
+SDL_Surface* halve_surface( SDL_Surface *src, SDL_AtomicInt *cancel ){
+
+    SDL_Surface *dst = SDL_CreateSurface( (src->w + 1) / 2, (src->h + 1) / 2, SDL_PIXELFORMAT_RGBA32 );
+    if( !dst ){
+        SDL_Log("Failed to create surface: %s", SDL_GetError());
+        return NULL;
+    }
+    Halve_Job J = (Halve_Job){ src, dst, 0, cancel };
+    int bands = POOL? 4 * POOL->N : 1;
+    J.band_h = SDL_max( 16, (dst->h + bands-1) / bands );
+    bands = (dst->h + J.band_h-1) / J.band_h;
+
+    SDL_LockSurface(src);
+    SDL_LockSurface(dst);
+    if( POOL && bands > 1 ){
+        Job_Group G = {0};
+        for (int b = 0; b < bands; b++) pool_submit( POOL, &G, halve_band, &J, b );
+        pool_wait( POOL, &G );
+    }
+    else{
+        for (int b = 0; b < bands; b++) halve_band( &J, b );
+    }
+    SDL_UnlockSurface(src);
+    SDL_UnlockSurface(dst);
+
+    if( cancel && SDL_GetAtomicInt( cancel ) ){
+        SDL_DestroySurface( dst );
+        return NULL;
+    }
+    return dst;
+}
+
+
+
+/* The window-fit level of big images is kept on disk, so opening one again can put it up right
+   away instead of waiting out the whole decode. Files are named by a hash of the absolute path,
+   size and mtime, so a changed file just misses; they hold a small header and raw RGBA32 rows.
+   The least recently used go once there's more than THUMB_STORE_BUDGET of them, going by mtime,
+   which every hit brings up to date. */
+#define THUMB_STORE_BUDGET ( 1024 * 1024 * 1024 )
+#define THUMB_MIN_RATIO 4// not worth it unless the image has this many times the thumbnail's pixels
+
+typedef struct {
+	char magic [4];// "IVT1"
+	Uint32 w, h;// the thumbnail's
+	Uint32 full_w, full_h;// the image's
+} Thumb_Header;
+
+char *thumb_dir = NULL;// NULL if there's nowhere to keep them
+
+void init_thumb_store(){
+	char *pref = SDL_GetPrefPath( "Introscopia", "ImageViewer" );
+	if( pref == NULL ) return;
+	size_t len = SDL_strlen( pref ) + 8;
+	thumb_dir = SDL_malloc( len );
+	SDL_snprintf( thumb_dir, len, "%sthumbs/", pref );
+	SDL_free( pref );
+	if( !SDL_CreateDirectory( thumb_dir ) ){
+		SDL_Log( "no thumbnail store: %s", SDL_GetError() );
+		SDL_free( thumb_dir );
+		thumb_dir = NULL;
+	}
+}
+
+static void thumb_file( char *out, size_t len, const char *path, Uint64 fsize, SDL_Time mtime ){
+
+	char *cwd = NULL;// folder entries are relative to it
+	if( path[0] != '/' && path[0] != '\\' && !( path[0] && path[1] == ':' ) ){
+		cwd = SDL_GetCurrentDirectory();
+	}
+	Uint64 hash = 14695981039346656037ULL;// FNV-1a
+	for( const char *c = cwd; c && *c; ++c ){ hash = ( hash ^ (Uint8)*c ) * 1099511628211ULL; }
+	for( const char *c = path; *c; ++c ){ hash = ( hash ^ (Uint8)*c ) * 1099511628211ULL; }
+	Uint64 stamp [2] = { fsize, (Uint64) mtime };
+	for (int i = 0; i < (int) sizeof(stamp); ++i ){
+		hash = ( hash ^ ((Uint8*) stamp)[i] ) * 1099511628211ULL;
+	}
+	SDL_free( cwd );
+	SDL_snprintf( out, len, "%s%016llx.ivt", thumb_dir, (unsigned long long) hash );
+}
+
+static bool read_thumb_header( SDL_IOStream *io, Thumb_Header *H ){
+	return SDL_ReadIO( io, H, sizeof(Thumb_Header) ) == sizeof(Thumb_Header)
+	    && SDL_memcmp( H->magic, "IVT1", 4 ) == 0
+	    && H->w > 0 && H->h > 0 && H->w <= 16384 && H->h <= 16384;
+}
+
+// NULL if there's none for this version of the file
+SDL_Surface *load_thumb( const char *path, Uint64 fsize, SDL_Time mtime, int *full_w, int *full_h ){
+
+	if( thumb_dir == NULL ) return NULL;
+	char file [1024];
+	thumb_file( file, 1024, path, fsize, mtime );
+	SDL_IOStream *io = SDL_IOFromFile( file, "r+b" );// written to on a hit
+	if( io == NULL ) io = SDL_IOFromFile( file, "rb" );// a read-only store still works, as oldest-first
+	if( io == NULL ) return NULL;
+
+	Thumb_Header H;
+	SDL_Surface *S = NULL;
+	if( read_thumb_header( io, &H ) ){
+		S = SDL_CreateSurface( H.w, H.h, SDL_PIXELFORMAT_RGBA32 );
+	}
+	for (int y = 0; S && y < S->h; ++y ){
+		if( SDL_ReadIO( io, (Uint8*) S->pixels + y * S->pitch, S->w * 4 ) != (size_t) S->w * 4 ){
+			SDL_DestroySurface( S );// cut short
+			S = NULL;
+		}
+	}
+	if( S ){// the magic goes back over itself, for the mtime
+		SDL_SeekIO( io, 0, SDL_IO_SEEK_SET );
+		SDL_WriteIO( io, H.magic, 4 );
+	}
+	SDL_CloseIO( io );
+	if( S ){
+		*full_w = H.full_w;
+		*full_h = H.full_h;
+	}
+	return S;
+}
+
+// S is RGBA32. Written to the side and renamed into place, so a reader never sees half of it
+void save_thumb( const char *path, Uint64 fsize, SDL_Time mtime, SDL_Surface *S, int full_w, int full_h ){
+
+	if( thumb_dir == NULL ) return;
+	char file [1024];
+	char temp [1040];
+	thumb_file( file, 1024, path, fsize, mtime );
+
+	Thumb_Header H;
+	SDL_IOStream *io = SDL_IOFromFile( file, "rb" );
+	if( io ){
+		bool same = read_thumb_header( io, &H ) && H.w == (Uint32) S->w && H.h == (Uint32) S->h;
+		SDL_CloseIO( io );
+		if( same ) return;// already there, for this window size
+	}
+
+	SDL_snprintf( temp, sizeof(temp), "%s.%llx", file, (unsigned long long) SDL_GetCurrentThreadID() );
+	io = SDL_IOFromFile( temp, "wb" );
+	if( io == NULL ) return;
+	H = (Thumb_Header){ .w = S->w, .h = S->h, .full_w = full_w, .full_h = full_h };
+	SDL_memcpy( H.magic, "IVT1", 4 );
+	bool ok = SDL_WriteIO( io, &H, sizeof(Thumb_Header) ) == sizeof(Thumb_Header);
+	for (int y = 0; ok && y < S->h; ++y ){
+		ok = SDL_WriteIO( io, (Uint8*) S->pixels + y * S->pitch, S->w * 4 ) == (size_t) S->w * 4;
+	}
+	ok = SDL_CloseIO( io ) && ok;
+	if( !ok || !SDL_RenamePath( temp, file ) ){
+		SDL_Log( "couldn't store thumbnail for %s: %s", path, SDL_GetError() );
+		SDL_RemovePath( temp );
+	}
+}
+
+typedef struct {
+	char *name;
+	Uint64 size;
+	SDL_Time mtime;
+} Thumb_File;
+
+typedef struct ok_vec_of( Thumb_File ) thumb_vec;
+
+static SDL_EnumerationResult list_thumbs( void *userdata, const char *dirname, const char *fname ){
+	char file [1024];
+	SDL_PathInfo info;
+	SDL_snprintf( file, 1024, "%s%s", dirname, fname );
+	if( SDL_GetPathInfo( file, &info ) && info.type == SDL_PATHTYPE_FILE ){
+		Thumb_File T = { SDL_strdup( fname ), info.size, info.modify_time };
+		ok_vec_push( (thumb_vec*) userdata, T );
+	}
+	return SDL_ENUM_CONTINUE;
+}
+
+static int compare_thumb_age( const void *a, const void *b ){
+	SDL_Time A = ((const Thumb_File*) a)->mtime;
+	SDL_Time B = ((const Thumb_File*) b)->mtime;
+	return ( A > B ) - ( A < B );
+}
+
+// a pool job, so startup needn't wait on it. Least recently used first
+void prune_thumb_store( void *data, int index ){
+	(void) data;
+	(void) index;
+
+	if( thumb_dir == NULL ) return;
+	thumb_vec files;
+	ok_vec_init( &files );
+	SDL_EnumerateDirectory( thumb_dir, list_thumbs, &files );
+
+	Uint64 total = 0;
+	ok_vec_foreach( &files, Thumb_File T ){ total += T.size; }
+	SDL_qsort( ok_vec_begin( &files ), ok_vec_count( &files ), sizeof(Thumb_File), compare_thumb_age );
+
+	char file [1024];
+	for (int i = 0; i < (int) ok_vec_count( &files ); ++i ){
+		Thumb_File *T = ok_vec_get_ptr( &files, i );
+		if( total > THUMB_STORE_BUDGET ){
+			SDL_snprintf( file, 1024, "%s%s", thumb_dir, T->name );
+			if( SDL_RemovePath( file ) ) total -= T->size;
+		}
+		SDL_free( T->name );
+	}
+	ok_vec_deinit( &files );
+}
+
+
+#define MAX_MIPS 24
+
+/* Builds the mip chain of a big image in the background: 1/2, 1/4, 1/8... each box-filtered from
+   the one before, down to the last power of two that's still bigger than the window, and then
+   one last level scale_n_blur'd to fit the window exactly.
+   Finished levels wait in `levels` until check_mip_task() uploads them. */
+typedef struct {
+    SDL_Mutex* lock;
+    char filepath[1024];
+    SDL_Surface* source;// if set it's used instead of loading filepath
+    bool owns_source;// otherwise it's borrowed
+    int target_w, target_h;
+    float blur_factor;
+    SDL_Surface* levels[ MAX_MIPS ];
+    int produced, taken;
+    int completed;
+    bool abandoned;// cancelled while the job was still on it, which then frees it
+    SDL_Surface* left;// a borrowed source whose owner's gone, freed with the task
+    SDL_AtomicInt cancel_requested;
+} BigImg_Mip_Task;
+
+static void free_mip_task( BigImg_Mip_Task* task ){
+    for (int i = task->taken; i < task->produced; ++i ){
+        SDL_DestroySurface( task->levels[i] );
+    }
+    SDL_DestroySurface( task->left );
+    SDL_DestroyMutex( task->lock );
+    SDL_free( task );
+}
+
+static void publish_mip( BigImg_Mip_Task* task, SDL_Surface *level ){
+    SDL_LockMutex( task->lock );
+    if( SDL_GetAtomicInt( &(task->cancel_requested) ) || task->produced >= MAX_MIPS ){
+        SDL_DestroySurface( level );
+    } else {
+        task->levels[ task->produced++ ] = level;
+    }
+    SDL_UnlockMutex( task->lock );
+    wake_main();
+}
+
+static void mip_job( void* data, int index ) {
+    (void) index;
+    BigImg_Mip_Task* task = (BigImg_Mip_Task*)data;
+    SDL_AtomicInt *cancel = &(task->cancel_requested);
+
+    SDL_PathInfo info;// what the thumbnail gets filed under
+    bool keyed = SDL_GetPathInfo( task->filepath, &info );
+
+    SDL_Surface* prev = task->source;
+    bool own_prev = task->owns_source;
+    if( !prev && !SDL_GetAtomicInt( cancel ) ){
+        prev = IMG_Load( task->filepath );
+        own_prev = true;
+        if (!prev) SDL_Log("Failed to load image: %s", SDL_GetError());
+    }
+    if( prev && SDL_GetAtomicInt( cancel ) ){// dropped before it got going, the convert alone is a whole copy
+        if( own_prev ) SDL_DestroySurface( prev );
+        prev = NULL;
+    }
+    if( prev && prev->format != SDL_PIXELFORMAT_RGBA32 ){
+        SDL_Surface* conv = SDL_ConvertSurface(prev, SDL_PIXELFORMAT_RGBA32);
+        if( own_prev ) SDL_DestroySurface(prev);
+        prev = conv;
+        own_prev = true;
+    }
+
+    if( prev ){
+        int full_w = prev->w, full_h = prev->h;
+        SDL_FRect fit = (SDL_FRect){ 0, 0, prev->w, prev->h };
+        SDL_Rect trct = (SDL_Rect){ 0, 0, task->target_w, task->target_h };
+        fit_rect( &fit, &trct );
+
+        // each level is only handed over once the next one's been made from it
+        bool full_res = true;
+        while( !SDL_GetAtomicInt( cancel ) && prev->w / 2 >= fit.w && prev->h / 2 >= fit.h ){
+            SDL_Surface *next = halve_surface( prev, cancel );
+            if( !next ) break;
+            if( !full_res ) publish_mip( task, prev );
+            else if( own_prev ) SDL_DestroySurface( prev );
+            prev = next;
+            full_res = false;
+        }
+        SDL_Surface *last = NULL;
+        if( !SDL_GetAtomicInt( cancel ) ){
+            last = scale_n_blur( prev, task->target_w, task->target_h, task->blur_factor, cancel );
+        }
+        if( !full_res ) publish_mip( task, prev );
+        else if( own_prev ) SDL_DestroySurface( prev );
+        if( last && keyed && (Sint64) full_w * full_h >= THUMB_MIN_RATIO * (Sint64) last->w * last->h ){
+            save_thumb( task->filepath, info.size, info.modify_time, last, full_w, full_h );
+        }
+        if( last ) publish_mip( task, last );
+    }
+
+    SDL_LockMutex( task->lock );
+    task->completed = 1;
+    bool abandoned = task->abandoned;
+    SDL_UnlockMutex( task->lock );
+    if( abandoned ) free_mip_task( task );
+    else wake_main();
+}
+
+/* source may be NULL to have it load filepath. If give_source the task takes it over,
+   otherwise it must outlive the task */
+BigImg_Mip_Task* launch_mip_task( const char* filepath, SDL_Surface *source, bool give_source, int w, int h, float blur) {
+
+    BigImg_Mip_Task* task = SDL_calloc( 1, sizeof(BigImg_Mip_Task) );
+    *task = (BigImg_Mip_Task){
+        .lock = SDL_CreateMutex(),
+        .source = source,
+        .owns_source = give_source,
+        .target_w = w,
+        .target_h = h,
+        .blur_factor = blur
+    };
+    SDL_strlcpy(task->filepath, filepath, sizeof(task->filepath));
+    
+    pool_submit( POOL, NULL, mip_job, task, 0 );
+    return task;
+}
+
+// uploads whichever levels are ready onto the end of mips. returns 1 once the task is all done
+int check_mip_task( SDL_Renderer *R, BigImg_Mip_Task* task, SDL_Texture **mips, int *mip_count ){
+    SDL_LockMutex( task->lock );
+    while( task->taken < task->produced ){
+        SDL_Surface *level = task->levels[ task->taken ];
+        task->levels[ task->taken++ ] = NULL;
+        SDL_Texture *T = SDL_CreateTextureFromSurface( R, level );
+        if (!T) {
+            SDL_Log("Failed to create texture: %s", SDL_GetError());
+        } else {
+            mips[ (*mip_count)++ ] = T;
+        }
+        SDL_DestroySurface( level );
+    }
+    int done = task->completed;
+    SDL_UnlockMutex(task->lock);
+    return done;
+}
+
+/* Doesn't wait on the job, navigating away mustn't stall behind it: if it's still going it frees
+   the task itself once it notices. lent is the task's borrowed source when its owner is going
+   too, it's freed along with the task. NULL otherwise */
+void cancel_and_destroy_task( BigImg_Mip_Task* task, SDL_Surface *lent ){
+    SDL_SetAtomicInt( &(task->cancel_requested), 1 );
+    SDL_LockMutex( task->lock );
+    task->left = lent;
+    bool done = task->completed;
+    task->abandoned = !done;
+    SDL_UnlockMutex( task->lock );
+    if( done ) free_mip_task( task );
+}
+
+
+
+
+/* Images bigger than max_T_size can't be one texture, so they're kept as a surface and cut into
+   TILE_SIZE tiles which are only uploaded when they're on screen. At most TILE_CACHE_CAP of them
+   are resident at once, the least recently drawn ones get evicted. */
+#define TILE_SIZE 1024
+#define TILE_CACHE_CAP 64 // ~256MB of VRAM at 1024x1024 RGBA
+#define TILE_UPLOADS_PER_FRAME 6
+
+typedef struct {
+	SDL_Surface *SURF;// the whole image, RGBA32
+	int ts, gx, gy;
+	SDL_Texture **TILES;// gx * gy, NULL when not resident
+	int resident [ TILE_CACHE_CAP ];// indices into TILES
+	Uint64 last_used [ TILE_CACHE_CAP ];
+	int resident_n;
+	Uint64 clock;
+} Tile_Cache;
+
+// takes ownership of SURF
+Tile_Cache *create_tile_cache( SDL_Surface *SURF ){
+	Tile_Cache *TC = SDL_calloc( 1, sizeof(Tile_Cache) );
+	TC->SURF = SURF;
+	TC->ts = SDL_min( TILE_SIZE, max_T_size );
+	TC->gx = (SURF->w + TC->ts-1) / TC->ts;
+	TC->gy = (SURF->h + TC->ts-1) / TC->ts;
+	TC->TILES = SDL_calloc( TC->gx * TC->gy, sizeof(SDL_Texture*) );
+	return TC;
+}
+
+void destroy_tile_cache( Tile_Cache *TC ){
+	for (int r = 0; r < TC->resident_n; ++r ){
+		SDL_DestroyTexture( TC->TILES[ TC->resident[r] ] );
+	}
+	SDL_free( TC->TILES );
+	SDL_DestroySurface( TC->SURF );
+	SDL_free( TC );
+}
+
+static SDL_Texture *get_tile( SDL_Renderer *R, Tile_Cache *TC, int t, int *uploads ){
+
+	for (int r = 0; r < TC->resident_n; ++r ){
+		if( TC->resident[r] == t ){
+			TC->last_used[r] = TC->clock;
+			return TC->TILES[t];
+		}
+	}
+	if( *uploads <= 0 ) return NULL;
+	*uploads -= 1;
+
+	int slot = TC->resident_n;
+	if( TC->resident_n == TILE_CACHE_CAP ){
+		slot = 0;
+		for (int r = 1; r < TC->resident_n; ++r ){
+			if( TC->last_used[r] < TC->last_used[slot] ) slot = r;
+		}
+		SDL_DestroyTexture( TC->TILES[ TC->resident[slot] ] );
+		TC->TILES[ TC->resident[slot] ] = NULL;
+	}
+	else TC->resident_n += 1;
+
+	int x = (t % TC->gx) * TC->ts;
+	int y = (t / TC->gx) * TC->ts;
+	SDL_Surface *view = SDL_CreateSurfaceFrom( SDL_min( TC->ts, TC->SURF->w - x ),
+	                                           SDL_min( TC->ts, TC->SURF->h - y ),
+	                                           TC->SURF->format,
+	                                           (Uint8*)TC->SURF->pixels + (size_t) y * TC->SURF->pitch + 4 * x,
+	                                           TC->SURF->pitch );
+	TC->TILES[t] = SDL_CreateTextureFromSurface( R, view );
+	SDL_DestroySurface( view );
+	if( TC->TILES[t] == NULL ){
+		SDL_Log( "Failed to create tile texture: %s", SDL_GetError() );
+	}
+	else SDL_SetTextureScaleMode( TC->TILES[t], antialiasing );
+
+	TC->resident[slot] = t;
+	TC->last_used[slot] = TC->clock;
+	return TC->TILES[t];
+}
+
+// whether more than TILE_CACHE_CAP tiles could land on window_rect at scale. Turned a quarter it's the same
+bool tiles_overflow( Tile_Cache *TC, float scale ){
+	float side = scale * TC->ts;
+	int across = SDL_min( (int) SDL_ceilf( window_rect.w / side ) + 1, TC->gx );
+	int down   = SDL_min( (int) SDL_ceilf( window_rect.h / side ) + 1, TC->gy );
+	return across * down > TILE_CACHE_CAP;
+}
+
+/* Draws the tiles that land on window_rect, for the whole image going in DST, rotated by angle
+   degrees about DST's center. Returns how many visible tiles are still waiting to be uploaded,
+   or -1 if too many are visible to be drawn from tiles at all. */
+int render_tiles( SDL_Renderer *R, Tile_Cache *TC, SDL_FRect *DST, double angle, SDL_FlipMode flip ){
+
+	TC->clock += 1;
+	float s = DST->w / TC->SURF->w;
+	float c = SDL_cos( angle * SDL_PI_D / 180.0 );
+	float n = SDL_sin( angle * SDL_PI_D / 180.0 );
+	float Cx = DST->x + 0.5 * DST->w;
+	float Cy = DST->y + 0.5 * DST->h;
+
+	int visible [ TILE_CACHE_CAP ];
+	SDL_FRect rects [ TILE_CACHE_CAP ];
+	int vn = 0;
+
+	for (int t = 0; t < TC->gx * TC->gy; ++t ){
+		SDL_FRect tr;
+		tr.x = (t % TC->gx) * TC->ts;
+		tr.y = (t / TC->gx) * TC->ts;
+		tr.w = s * SDL_min( TC->ts, TC->SURF->w - tr.x );
+		tr.h = s * SDL_min( TC->ts, TC->SURF->h - tr.y );
+		tr.x = DST->x + s * tr.x;
+		tr.y = DST->y + s * tr.y;
+		if( flip & SDL_FLIP_HORIZONTAL ) tr.x = DST->x + DST->w - (tr.x - DST->x) - tr.w;
+		if( flip & SDL_FLIP_VERTICAL   ) tr.y = DST->y + DST->h - (tr.y - DST->y) - tr.h;
+
+		// move the tile's center around the image's center, the tile turns about its own
+		float dx = tr.x + 0.5 * tr.w - Cx;
+		float dy = tr.y + 0.5 * tr.h - Cy;
+		tr.x = Cx + dx*c - dy*n - 0.5 * tr.w;
+		tr.y = Cy + dx*n + dy*c - 0.5 * tr.h;
+
+		float aw = tr.w * SDL_fabsf(c) + tr.h * SDL_fabsf(n);
+		float ah = tr.w * SDL_fabsf(n) + tr.h * SDL_fabsf(c);
+		float ax = tr.x + 0.5 * (tr.w - aw);
+		float ay = tr.y + 0.5 * (tr.h - ah);
+		if( ax + aw < window_rect.x || ax > window_rect.x + window_rect.w ||
+		    ay + ah < window_rect.y || ay > window_rect.y + window_rect.h ) continue;
+
+		if( vn == TILE_CACHE_CAP ) return -1;
+		visible[vn] = t;
+		rects[vn] = tr;
+		vn++;
+	}
+
+	int uploads = TILE_UPLOADS_PER_FRAME;
+	int missing = 0;
+	for (int v = 0; v < vn; ++v ){
+		SDL_Texture *tile = get_tile( R, TC, visible[v], &uploads );
+		if( tile == NULL ){
+			missing++;
+			continue;
+		}
+		if( angle != 0 || flip != SDL_FLIP_NONE ){
+			SDL_RenderTextureRotated( R, tile, NULL, rects + v, angle, NULL, flip );
+		} else {
+			SDL_RenderTexture( R, tile, NULL, rects + v );
+		}
+	}
+	return missing;
+}
+
+
+typedef struct image_struct{
+
+	int type;
+
+	union{
+
+		SDL_Texture *TEXTURE;
+
+		struct {
+			SDL_Texture *ORIGINAL;
+			SDL_Texture *MIPS[ MAX_MIPS ];// getting smaller, the last one fits the window
+			int mip_count;
+			BigImg_Mip_Task *task;
+			Tile_Cache *tiles;// only when it's too big for ORIGINAL, which is then NULL
+			SDL_Texture *PREVIEW;// what stood in while it decoded, kept for tiled ones until the mips are done
+		} B;// Big image
+
+		struct {
+			SDL_Texture *TEXTURE;// the frame that's up, the next one gets written over it
+			struct anim_delta_struct *deltas;// deltas[f] turns frame f-1 into frame f, and [0] the last into the first
+			int framecount;
+			size_t bytes;// in the deltas
+			int FRAME;
+			Uint64 NFRAME;// SDL_GetTicksNS() when the next one's due
+			int SHOWN;// the frame that's on screen. FRAME going past it means it needs a redraw
+			struct anim_stream_struct *stream;// while frames are still coming from the decoder
+		} A;// Animation
+
+	} U;
+
+	SDL_Rect RCT;
+
+	char *path;// what it was loaded from, with the file's size and mtime at the time
+	Uint64 fsize;
+	SDL_Time mtime;
+
+	struct image_atlas_struct *ATLAS;// if it's SIMPLE and small it can be in one of those as well
+	SDL_FRect ATLAS_SRC;
+
+	struct svg_view_struct *SVG;// a SIMPLE that's the base raster of an svg, for re-rendering it zoomed in
+
+} Image;
+
+enum image_type { INVALID = 0, SIMPLE, BIG, ANIMATION };
+
+#define ANIM_SLACK SDL_MS_TO_NS( 8 ) // a frame may go up this early, so ones due around the same time share a redraw
+#define ANIM_BEHIND SDL_MS_TO_NS( 250 ) // how late a streamed one can run before its schedule starts over
+
+/* Consecutive frames mostly differ in a small patch, if at all, so animations are kept as one
+   streaming texture and a delta per frame: the rectangle that changed and its pixels. Going to
+   the next frame is an upload of just that much. Frames are all the same 4 bytes per pixel format. */
+typedef struct anim_delta_struct{
+	SDL_Rect r;// empty if nothing changed
+	Uint8 *pixels;// r.w × r.h of them, packed
+	int delay;// how long the frame it makes stays up
+} Anim_Delta;
+
+static bool same_pixels( SDL_Surface *A, SDL_Surface *B, int y, int x0, int x1 ){
+	Uint8 *a = (Uint8*) A->pixels + y * A->pitch + 4 * x0;
+	Uint8 *b = (Uint8*) B->pixels + y * B->pitch + 4 * x0;
+	return SDL_memcmp( a, b, 4 * ( x1 - x0 ) ) == 0;
+}
+
+// what turns prev into next, all of it if there's no prev
+Anim_Delta make_delta( SDL_Surface *prev, SDL_Surface *next, int delay ){
+
+	SDL_Rect r = (SDL_Rect){ 0, 0, next->w, next->h };
+	if( prev ){
+		int w = next->w;
+		int y0 = 0, y1 = next->h;
+		while( y0 < y1 && same_pixels( prev, next, y0, 0, w ) ) y0++;
+		while( y1 > y0 && same_pixels( prev, next, y1-1, 0, w ) ) y1--;
+		// narrowing in on the columns, a pixel at a time
+		int x0 = 0, x1 = w;
+		if( y0 < y1 ){
+			while( x0 < x1 ){
+				bool same = true;
+				for (int y = y0; y < y1 && same; ++y ) same = same_pixels( prev, next, y, x0, x0+1 );
+				if( !same ) break;
+				x0++;
+			}
+			while( x1 > x0 ){
+				bool same = true;
+				for (int y = y0; y < y1 && same; ++y ) same = same_pixels( prev, next, y, x1-1, x1 );
+				if( !same ) break;
+				x1--;
+			}
+		}
+		r = (SDL_Rect){ x0, y0, x1 - x0, y1 - y0 };
+		if( r.w <= 0 || r.h <= 0 ) r = (SDL_Rect){ 0, 0, 0, 0 };
+	}
+
+	Anim_Delta D = (Anim_Delta){ r, NULL, delay };
+	if( r.w > 0 ){
+		D.pixels = SDL_malloc( 4 * r.w * r.h );
+		for (int y = 0; y < r.h; ++y ){
+			SDL_memcpy( D.pixels + 4 * r.w * y, (Uint8*) next->pixels + ( r.y + y ) * next->pitch + 4 * r.x, 4 * r.w );
+		}
+	}
+	return D;
+}
+
+static size_t delta_bytes( Anim_Delta *D ){
+	return 4 * (size_t) D->r.w * D->r.h;
+}
+
+static void apply_delta( SDL_Texture *T, Anim_Delta *D ){
+	if( D->r.w > 0 ) SDL_UpdateTexture( T, &(D->r), D->pixels, 4 * D->r.w );
+}
+
+// the texture the frames get written into, showing F
+static SDL_Texture *animation_texture( SDL_Surface *F ){
+	SDL_Texture *T = SDL_CreateTexture( R, F->format, SDL_TEXTUREACCESS_STREAMING, F->w, F->h );
+	SDL_SetTextureBlendMode( T, SDL_BLENDMODE_BLEND );
+	SDL_UpdateTexture( T, NULL, F->pixels, F->pitch );
+	return T;
+}
+
+// moves on to frame f, which must come right after the present one
+static void animation_step( Image *img, int f ){
+	Anim_Delta *D = img->U.A.deltas + f;
+	apply_delta( img->U.A.TEXTURE, D );
+	// nothing changed, so whatever was on screen still is
+	if( D->r.w == 0 && img->U.A.SHOWN == img->U.A.FRAME ) img->U.A.SHOWN = f;
+	img->U.A.FRAME = f;
+}
+
+#if SDL_IMAGE_VERSION_ATLEAST(3, 4, 0)
+#define ANIM_STREAMING
+#endif
+
+#ifdef ANIM_STREAMING
+/* Animations are decoded on the worker pool a few frames ahead of where they're shown, into a
+   ring of deltas the main thread takes them from as they come due, so one starts playing as soon
+   as its first frame is out. The first time through the deltas are all kept, and if that turns
+   out to be all of them within ANIM_KEEP_BYTES the decoder goes and it just cycles through those.
+   Otherwise they're dropped and it streams from then on, so however long it is it never holds
+   more than ANIM_RING frames' worth. */
+#define ANIM_RING 4
+#define ANIM_KEEP_BYTES (128 * 1024 * 1024)
+
+typedef struct anim_stream_struct{
+	IMG_AnimationDecoder *decoder;// the rest of these are the job's, once it's been started
+	SDL_PixelFormat format;
+	SDL_Surface *prev;// the last frame decoded, what the next is diffed against
+	SDL_Surface *first;// kept while keeping, the last frame gets diffed against it to loop
+	SDL_Mutex *lock;// over everything below
+	Anim_Delta ring [ ANIM_RING ];
+	int head, count;
+	Anim_Delta loop;// last to first, once it came to the end while keeping
+	bool running;// there's a job out filling the ring
+	bool keeping;// still on the first time through, keeping every frame
+	bool over;// came to the end while keeping
+	bool failed;
+	SDL_AtomicInt cancel;
+	Job_Group job;
+} Anim_Stream;
+
+static void anim_decode_job( void *data, int index ){
+	(void) index;
+
+	Anim_Stream *S = data;
+	while( 1 ){
+		// it only stops running under the lock, right as it sees there's nothing more to do
+		SDL_LockMutex( S->lock );
+		if( S->count == ANIM_RING || SDL_GetAtomicInt( &(S->cancel) ) ){
+			S->running = false;
+			SDL_UnlockMutex( S->lock );
+			return;
+		}
+		bool keeping = S->keeping;
+		SDL_UnlockMutex( S->lock );
+
+		if( !keeping && S->first ){
+			if( S->first != S->prev ) SDL_DestroySurface( S->first );
+			S->first = NULL;
+		}
+
+		SDL_Surface *F = NULL;
+		Uint64 duration = 0;
+		bool got = IMG_GetAnimationDecoderFrame( S->decoder, &F, &duration );
+		if( !got && IMG_GetAnimationDecoderStatus( S->decoder ) == IMG_DECODER_STATUS_COMPLETE ){
+			if( !keeping && IMG_ResetAnimationDecoder( S->decoder ) ) continue;// and round again
+		}
+		if( got && F->format != S->format ){
+			SDL_Surface *C = SDL_ConvertSurface( F, S->format );
+			SDL_DestroySurface( F );
+			F = C;
+		}
+		if( F == NULL ){
+			bool failed = got || IMG_GetAnimationDecoderStatus( S->decoder ) != IMG_DECODER_STATUS_COMPLETE;
+			if( failed ) SDL_Log( "animation frame: %s", SDL_GetError() );
+			// that's the end of it, kept it can still go round from what there is
+			Anim_Delta loop = (Anim_Delta){0};
+			if( keeping && S->first != S->prev ) loop = make_delta( S->prev, S->first, 0 );
+			SDL_LockMutex( S->lock );
+			S->loop = loop;
+			S->over = !failed;
+			S->failed = failed;
+			S->running = false;
+			SDL_UnlockMutex( S->lock );
+			wake_main();
+			return;
+		}
+
+		Anim_Delta D = make_delta( S->prev, F, duration > 0 ? duration : 100 );// like the browsers do
+		if( S->prev != S->first ) SDL_DestroySurface( S->prev );
+		S->prev = F;
+
+		SDL_LockMutex( S->lock );
+		S->ring[ ( S->head + S->count ) % ANIM_RING ] = D;
+		S->count += 1;
+		SDL_UnlockMutex( S->lock );
+		wake_main();
+	}
+}
+
+// the lock must be held
+static void refill_anim_stream( Anim_Stream *S ){
+	if( S->running || S->failed || ( S->over && S->keeping ) ) return;
+	S->over = false;// a switch to streaming came after it got to the end, it can go round
+	S->running = true;
+	pool_submit( POOL, &(S->job), anim_decode_job, S, 0 );
+}
+
+static void close_anim_stream( Anim_Stream *S ){
+	SDL_SetAtomicInt( &(S->cancel), 1 );
+	pool_wait( POOL, &(S->job) );
+	for (int i = 0; i < S->count; ++i ){
+		SDL_free( S->ring[ ( S->head + i ) % ANIM_RING ].pixels );
+	}
+	SDL_free( S->loop.pixels );
+	if( S->first != S->prev ) SDL_DestroySurface( S->first );
+	SDL_DestroySurface( S->prev );
+	IMG_CloseAnimationDecoder( S->decoder );
+	SDL_DestroyMutex( S->lock );
+	SDL_free( S );
+}
+
+/* Puts up whatever comes after the present frame, false if it isn't decoded yet.
+   While it's keeping, deltas grows a frame at a time, once it's streaming only deltas[0] is
+   kept, for its delay, and SHOWN gets knocked back to have the new frame drawn */
+static bool anim_next_frame( Image *img ){
+
+	Anim_Stream *S = img->U.A.stream;
+	Anim_Delta D = (Anim_Delta){0};
+	bool got = false;
+
+	SDL_LockMutex( S->lock );
+	if( S->count > 0 ){
+		D = S->ring[ S->head ];
+		S->head = ( S->head + 1 ) % ANIM_RING;
+		S->count -= 1;
+		got = true;
+	}
+	bool keeping = S->keeping;
+	refill_anim_stream( S );
+	bool over = !got && ( S->over || S->failed );
+	SDL_UnlockMutex( S->lock );
+
+	if( over ){
+		// that was all of it. Kept, it carries on round the deltas, otherwise (the decoder failed
+		// while streaming) it stops where it is. deltas[0] then holds no pixels to go round with
+		img->U.A.stream = NULL;
+		if( keeping ){
+			img->U.A.deltas[0].r = S->loop.r;
+			img->U.A.deltas[0].pixels = S->loop.pixels;
+			img->U.A.bytes += delta_bytes( &(S->loop) );
+			S->loop.pixels = NULL;
+		}
+		close_anim_stream( S );
+		if( !keeping || img->U.A.framecount == 1 ){// a still after all
+			SDL_Texture *T = img->U.A.TEXTURE;
+			SDL_free( img->U.A.deltas[0].pixels );
+			SDL_free( img->U.A.deltas );
+			img->type = SIMPLE;
+			img->U.TEXTURE = T;
+			return false;
+		}
+		animation_step( img, 0 );
+		return true;
+	}
+	if( !got ) return false;
+
+	int n = img->U.A.framecount;
+	if( keeping && img->U.A.bytes + delta_bytes( &D ) > ANIM_KEEP_BYTES ){
+		// too long to keep
+		for (int f = 0; f < n; ++f ) SDL_free( img->U.A.deltas[f].pixels );
+		img->U.A.framecount = 1;
+		img->U.A.bytes = 0;
+		SDL_LockMutex( S->lock );
+		S->keeping = false;
+		refill_anim_stream( S );
+		SDL_UnlockMutex( S->lock );
+		keeping = false;
+	}
+	if( keeping ){
+		img->U.A.deltas = SDL_realloc( img->U.A.deltas, ( n + 1 ) * sizeof( Anim_Delta ) );
+		img->U.A.deltas[n] = D;
+		img->U.A.framecount = n + 1;
+		img->U.A.bytes += delta_bytes( &D );
+		animation_step( img, n );
+	}
+	else{
+		apply_delta( img->U.A.TEXTURE, &D );
+		if( D.r.w > 0 ) img->U.A.SHOWN = -1;
+		SDL_free( D.pixels );
+		img->U.A.deltas[0] = (Anim_Delta){ D.r, NULL, D.delay };
+		img->U.A.FRAME = 0;
+	}
+	return true;
+}
+
+// puts up the first frame and leaves the rest to the workers. 0 if it can't be decoded at all
+static int open_animation( const char *path, Image *out ){
+
+	IMG_AnimationDecoder *D = IMG_CreateAnimationDecoder( path );
+	if( D == NULL ) return 0;
+
+	SDL_Surface *F = NULL;
+	Uint64 duration = 0;
+	if( !IMG_GetAnimationDecoderFrame( D, &F, &duration ) ){
+		IMG_CloseAnimationDecoder( D );
+		return 0;
+	}
+	if( SDL_BYTESPERPIXEL( F->format ) != 4 ){
+		SDL_Surface *C = SDL_ConvertSurface( F, SDL_PIXELFORMAT_RGBA32 );
+		SDL_DestroySurface( F );
+		F = C;
+		if( F == NULL ){
+			IMG_CloseAnimationDecoder( D );
+			return 0;
+		}
+	}
+
+	Anim_Stream *S = SDL_calloc( 1, sizeof(Anim_Stream) );
+	S->decoder = D;
+	S->format = F->format;
+	S->prev = F;
+	S->first = F;
+	S->lock = SDL_CreateMutex();
+	S->keeping = true;
+
+	out->type = ANIMATION;
+	out->U.A.stream = S;
+	out->U.A.TEXTURE = animation_texture( F );
+	out->U.A.framecount = 1;
+	out->U.A.deltas = SDL_calloc( 1, sizeof( Anim_Delta ) );// [0] becomes the loop delta
+	out->U.A.deltas[0].delay = duration > 0 ? duration : 100;
+	out->U.A.bytes = 0;
+	out->U.A.FRAME = 0;
+	out->U.A.SHOWN = -1;
+	out->U.A.NFRAME = SDL_GetTicksNS() + SDL_MS_TO_NS( out->U.A.deltas[0].delay );
+	out->RCT = (SDL_Rect){ 0, 0, F->w, F->h };
+
+	SDL_LockMutex( S->lock );
+	refill_anim_stream( S );
+	SDL_UnlockMutex( S->lock );
+	animating = 1;
+	return 1;
+}
+
+#else
+// without the decoder API every frame is decoded up front, but it's still only kept as deltas
+void process_animation( Image *img, IMG_Animation *ANIM ){
+	int n = ANIM->count;
+	SDL_Surface **frames = SDL_malloc( n * sizeof( SDL_Surface* ) );
+	for (int f = 0; f < n; ++f ){
+		frames[f] = ANIM->frames[f];
+		if( SDL_BYTESPERPIXEL( frames[f]->format ) != 4 || frames[f]->format != frames[0]->format ){
+			frames[f] = SDL_ConvertSurface( frames[f], f? frames[0]->format : SDL_PIXELFORMAT_RGBA32 );
+		}
+	}
+	img->type = ANIMATION;
+	img->U.A.TEXTURE = animation_texture( frames[0] );
+	img->U.A.framecount = n;
+	img->U.A.deltas = SDL_malloc( n * sizeof( Anim_Delta ) );
+	img->U.A.bytes = 0;
+	for (int f = 0; f < n; ++f ){
+		int delay = ANIM->delays[f] > 0 ? ANIM->delays[f] : 100;// like the browsers do
+		img->U.A.deltas[f] = make_delta( frames[ f? f-1 : n-1 ], frames[f], delay );
+		img->U.A.bytes += delta_bytes( img->U.A.deltas + f );
+	}
+	for (int f = 0; f < n; ++f ){
+		if( frames[f] != ANIM->frames[f] ) SDL_DestroySurface( frames[f] );
+	}
+	SDL_free( frames );
+	img->U.A.FRAME = 0;
+	img->U.A.SHOWN = -1;
+	img->U.A.stream = NULL;
+	img->U.A.NFRAME = SDL_GetTicksNS() + SDL_MS_TO_NS( img->U.A.deltas[0].delay );
+	img->RCT = (SDL_Rect){ 0, 0, ANIM->w, ANIM->h };
+}
+#endif
+
+// ns for one time round
+static Uint64 animation_period( Image *img ){
+	Uint64 ms = 0;
+	for (int f = 0; f < img->U.A.framecount; ++f ) ms += img->U.A.deltas[f].delay;
+	return SDL_MS_TO_NS( ms );
+}
+
+/* Brings it up to whichever frame should be up at now, true if that's a different one.
+   Frames are due at fixed times from when it started, a late one doesn't push the rest back:
+   if several came due since the last tick, it goes through them all in one go. One that's been
+   off screen for a while comes straight round to where it would have been */
+bool animation_tick( Image *img, Uint64 now ){
+
+	if( now + ANIM_SLACK < img->U.A.NFRAME ) return false;
+
+	if( img->U.A.stream == NULL && now >= img->U.A.NFRAME ){
+		Uint64 period = animation_period( img );
+		if( period > 0 ) img->U.A.NFRAME += ( now - img->U.A.NFRAME ) / period * period;
+	}
+
+	bool moved = false;
+	while( now + ANIM_SLACK >= img->U.A.NFRAME ){
+		#ifdef ANIM_STREAMING
+		if( img->U.A.stream ){
+			// the decoder wakes the loop when it's caught up. It can end up a still, as well
+			if( !anim_next_frame( img ) ) break;
+		}
+		else
+		#endif
+		animation_step( img, cycle( img->U.A.FRAME + 1, 0, img->U.A.framecount ) );
+		img->U.A.NFRAME += SDL_MS_TO_NS( img->U.A.deltas[ img->U.A.FRAME ].delay );
+		moved = true;
+	}
+	#ifdef ANIM_STREAMING
+	// what hasn't been decoded can't be skipped, so one that's fallen well behind picks up from here
+	if( img->type == ANIMATION && img->U.A.stream && now > img->U.A.NFRAME + ANIM_BEHIND ) img->U.A.NFRAME = now;
+	#endif
+	return moved;
+}
+
+/* Ticks the animations among the first `shown` of visible (or of imgs, with visible NULL),
+   the ones off screen are left alone. dirty is set if any of them has a frame to show that
+   isn't on screen yet. Returns when the soonest of them is due next, in SDL_GetTicksNS() time,
+   which is as long as the loop needs to sleep for them. 0 if there's none */
+Uint64 tick_animations( Image *imgs, int *visible, int shown, bool *dirty ){
+	Uint64 now = SDL_GetTicksNS();
+	Uint64 soonest = 0;
+	for (int v = 0; v < shown; ++v ){
+		Image *img = imgs + ( visible? visible[v] : v );
+		if( img->type != ANIMATION ) continue;
+		animation_tick( img, now );
+		if( img->type != ANIMATION ) continue;// turned out to be a still
+		if( img->U.A.FRAME != img->U.A.SHOWN ) *dirty = true;
+		if( img->U.A.stream && now + ANIM_SLACK >= img->U.A.NFRAME ) continue;// stalled, it'll wake the loop
+		if( soonest == 0 || img->U.A.NFRAME < soonest ) soonest = img->U.A.NFRAME;
+	}
+	return soonest;
+}
+
+/* the smallest level that's still at least as big as it'll be drawn.
+   NULL means draw the tiles: for tiled images that's only past 1/2 zoom and while they'd fit in
+   the tile cache, otherwise the biggest mip that could be uploaded is used instead, even if it's smaller */
+SDL_Texture *pick_mip( Image *img, float scale ){
+	SDL_Texture *TEX = img->U.B.ORIGINAL;
+	if( img->U.B.tiles && ( scale < 0.5 || tiles_overflow( img->U.B.tiles, scale ) ) ){
+		TEX = img->U.B.mip_count > 0 ? img->U.B.MIPS[0] : img->U.B.PREVIEW;
+	}
+	if( !enable_mips ) return TEX;
+	for (int m = 0; m < img->U.B.mip_count; ++m ){
+		float fw, fh;
+		SDL_GetTextureSize( img->U.B.MIPS[m], &fw, &fh );
+		if( fw < scale * img->RCT.w * 0.999f ) break;
+		TEX = img->U.B.MIPS[m];
+	}
+	return TEX;
+}
+
+/* SVGs are rasterized once at document size when they're loaded, which is what's drawn up to 1:1.
+   Zoomed in past that, the part of it in the window gets rendered again on the worker pool at the
+   scale it's shown at, rounded up to a half-octave bucket, and drawn over it. The last few renders
+   are kept, so zooming within a bucket, panning back or zooming back costs nothing. There's one
+   job at a time per document and the latest ask wins, the ones in between are never rendered. */
+#define SVG_CACHE 3
+#define SVG_MARGIN 0.125f// of the window's extent, rendered around it so small pans stay sharp
+
+bool palette_func(void* closure, const char* name, int length, plutovg_color_t* color){
+    *color = PLUTOVG_MAKE_COLOR(5,5,5,255);
+    return true;
+}
+
+typedef struct svg_render_struct{
+	int bucket;// rendered at 2^(bucket/2)
+	SDL_FRect area;// of the document, in its base raster's pixels
+	SDL_Texture *TEX;
+	Uint64 used;
+} Svg_Render;
+
+typedef struct svg_view_struct{
+	plutosvg_document_t *doc;
+	plutovg_rect_t bounds;
+	Svg_Render cache [ SVG_CACHE ];// main thread only, like these two
+	Uint64 clock;
+	Svg_Render asked;
+	SDL_Mutex *lock;// over everything below
+	Svg_Render want;
+	bool wanted;// want is waiting for the job
+	bool running;
+	SDL_Surface *done;// the job's latest, for the main thread to upload
+	Svg_Render done_as;
+	SDL_AtomicInt cancel;
+	Job_Group job;
+} Svg_View;
+
+static float svg_bucket_scale( int bucket ){
+	return SDL_powf( 2, 0.5f * bucket );
+}
+
+// area of the document at scale, onto a new ARGB8888 surface. Any thread, but not two on one doc
+static SDL_Surface *rasterize_svg( plutosvg_document_t *doc, plutovg_rect_t *bounds, SDL_FRect *area, float scale ){
+
+	int w = SDL_max( 1, (int) SDL_ceilf( area->w * scale ) );
+	int h = SDL_max( 1, (int) SDL_ceilf( area->h * scale ) );
+	SDL_Surface *S = SDL_CreateSurface( w, h, SDL_PIXELFORMAT_ARGB8888 );// cleared
+	if( S == NULL ) return NULL;
+
+	plutovg_surface_t *surface = plutovg_surface_create_for_data( S->pixels, w, h, S->pitch );
+	plutovg_canvas_t *canvas = plutovg_canvas_create( surface );
+	plutovg_canvas_scale( canvas, scale, scale );
+	plutovg_canvas_translate( canvas, -bounds->x - area->x, -bounds->y - area->y );
+
+	plutovg_color_t currentc = PLUTOVG_MAKE_COLOR(5,5,5,255);
+	plutosvg_document_render( doc, NULL, canvas, &currentc, palette_func, NULL );
+
+	plutovg_canvas_destroy( canvas );
+	plutovg_surface_destroy( surface );
+	return S;
+}
+
+static void svg_job( void *data, int index ){
+	(void) index;
+
+	Svg_View *V = data;
+	SDL_LockMutex( V->lock );
+	while( V->wanted && !SDL_GetAtomicInt( &(V->cancel) ) ){
+		Svg_Render want = V->want;
+		V->wanted = false;
+		SDL_UnlockMutex( V->lock );
+
+		float scale = svg_bucket_scale( want.bucket );
+		SDL_Surface *S = rasterize_svg( V->doc, &(V->bounds), &(want.area), scale );
+		if( S ){// what it covers to the pixel
+			want.area.w = S->w / scale;
+			want.area.h = S->h / scale;
+		}
+		else SDL_Log( "svg render: %s", SDL_GetError() );
+
+		SDL_LockMutex( V->lock );
+		if( S ){
+			SDL_DestroySurface( V->done );
+			V->done = S;
+			V->done_as = want;
+			SDL_UnlockMutex( V->lock );
+			wake_main();
+			SDL_LockMutex( V->lock );
+		}
+	}
+	V->running = false;
+	SDL_UnlockMutex( V->lock );
+}
+
+// takes over doc
+Svg_View *open_svg_view( plutosvg_document_t *doc, plutovg_rect_t bounds ){
+	Svg_View *V = SDL_calloc( 1, sizeof(Svg_View) );
+	if( V ) V->lock = SDL_CreateMutex();
+	if( V == NULL || V->lock == NULL ){
+		SDL_free( V );
+		plutosvg_document_destroy( doc );
+		return NULL;
+	}
+	V->doc = doc;
+	V->bounds = bounds;
+	return V;
+}
+
+void close_svg_view( Svg_View *V ){
+	SDL_SetAtomicInt( &(V->cancel), 1 );
+	pool_wait( POOL, &(V->job) );
+	for (int c = 0; c < SVG_CACHE; ++c ) SDL_DestroyTexture( V->cache[c].TEX );
+	SDL_DestroySurface( V->done );
+	plutosvg_document_destroy( V->doc );
+	SDL_DestroyMutex( V->lock );
+	SDL_free( V );
+}
+
+// stops the job and forgets what was asked of it, for a view that's put away with its renders
+void idle_svg_view( Svg_View *V ){
+	SDL_SetAtomicInt( &(V->cancel), 1 );
+	pool_wait( POOL, &(V->job) );
+	SDL_SetAtomicInt( &(V->cancel), 0 );
+	V->wanted = false;
+	SDL_DestroySurface( V->done );
+	V->done = NULL;
+	V->asked = (Svg_Render){0};
+}
+
+size_t svg_view_bytes( Svg_View *V ){
+	size_t bytes = 0;
+	for (int c = 0; c < SVG_CACHE; ++c ){
+		float w, h;
+		if( V->cache[c].TEX && SDL_GetTextureSize( V->cache[c].TEX, &w, &h ) ) bytes += 4 * (size_t) w * (size_t) h;
+	}
+	return bytes;
+}
+
+// uploads what the job's finished, over the least recently used render. True if there was something
+bool collect_svg_render( Svg_View *V ){
+
+	SDL_LockMutex( V->lock );
+	SDL_Surface *S = V->done;
+	Svg_Render as = V->done_as;
+	V->done = NULL;
+	SDL_UnlockMutex( V->lock );
+	if( S == NULL ) return false;
+
+	as.TEX = SDL_CreateTextureFromSurface( R, S );
+	SDL_DestroySurface( S );
+	if( as.TEX == NULL ) return false;
+	as.used = ++V->clock;
+
+	Svg_Render *slot = V->cache;
+	for (int c = 0; c < SVG_CACHE; ++c ){
+		if( V->cache[c].TEX == NULL ){
+			slot = V->cache + c;
+			break;
+		}
+		if( V->cache[c].used < slot->used ) slot = V->cache + c;
+	}
+	SDL_DestroyTexture( slot->TEX );
+	*slot = as;
+	return true;
+}
+
+// the part of an img_w x img_h image drawn at DST that's in the window, in the image's own pixels
+SDL_FRect image_area_in_window( SDL_FRect *DST, float img_w, float img_h, double angle, SDL_FlipMode flip ){
+
+	float s = DST->w / img_w;
+	float c = SDL_cos( angle * SDL_PI_D / 180.0 );
+	float n = SDL_sin( angle * SDL_PI_D / 180.0 );
+	float Cx = DST->x + 0.5 * DST->w;
+	float Cy = DST->y + 0.5 * DST->h;
+	float x0 = img_w, y0 = img_h, x1 = 0, y1 = 0;
+
+	for (int k = 0; k < 4; ++k ){
+		// turned back about the center, then unflipped
+		float dx = window_rect.x + ( k & 1 ? window_rect.w : 0 ) - Cx;
+		float dy = window_rect.y + ( k & 2 ? window_rect.h : 0 ) - Cy;
+		float x = Cx + dx*c + dy*n;
+		float y = Cy - dx*n + dy*c;
+		if( flip & SDL_FLIP_HORIZONTAL ) x = 2 * Cx - x;
+		if( flip & SDL_FLIP_VERTICAL   ) y = 2 * Cy - y;
+		x = ( x - DST->x ) / s;
+		y = ( y - DST->y ) / s;
+		x0 = SDL_min( x0, x ); x1 = SDL_max( x1, x );
+		y0 = SDL_min( y0, y ); y1 = SDL_max( y1, y );
+	}
+	x0 = SDL_max( x0, 0 ); x1 = SDL_min( x1, img_w );
+	y0 = SDL_max( y0, 0 ); y1 = SDL_min( y1, img_h );
+	return (SDL_FRect){ x0, y0, SDL_max( 0, x1 - x0 ), SDL_max( 0, y1 - y0 ) };
+}
+
+static bool frect_contains( SDL_FRect *outer, SDL_FRect *inner ){
+	float e = 0.5f;// of a base pixel, the renders are rounded out to whole pixels
+	return inner->x + e >= outer->x && inner->y + e >= outer->y
+	    && inner->x + inner->w <= outer->x + outer->w + e && inner->y + inner->h <= outer->y + outer->h + e;
+}
+
+/* What to draw over an SVG shown at s times its base raster (img_w x img_h), with the part in
+   the window being need: the kept render closest to the right bucket that covers need, or failing
+   that one that overlaps it. NULL if none does. Unless one in the right bucket covers need, a new
+   render gets asked for, of need and a margin around it. */
+Svg_Render *svg_render_for( Svg_View *V, SDL_FRect *need, float s, float img_w, float img_h, bool *covers ){
+
+	*covers = false;
+	if( s <= 1 || need->w <= 0 || need->h <= 0 ) return NULL;
+	int bucket = (int) SDL_ceilf( 2 * SDL_log2f( s ) );// finer than shown never, coarser up to 1.41x
+
+	Svg_Render *best = NULL;
+	int best_d = 0;
+	for (int c = 0; c < SVG_CACHE; ++c ){
+		Svg_Render *C = V->cache + c;
+		if( C->TEX == NULL || !SDL_HasRectIntersectionFloat( &(C->area), need ) ) continue;
+		bool all = frect_contains( &(C->area), need );
+		// covering beats not, then the bucket above beats the ones below
+		int d = C->bucket >= bucket ? 2 * (C->bucket - bucket) : 4 * (bucket - C->bucket) + 1;
+		if( !all ) d += 1000;
+		if( best == NULL || d < best_d ){
+			best = C;
+			best_d = d;
+		}
+	}
+	if( best ){
+		best->used = ++V->clock;
+		*covers = best_d < 1000;
+		if( best_d <= 2 * 2 ) return best;// up to a whole octave sharper than needed is fine
+	}
+
+	float scale = svg_bucket_scale( bucket );
+	float mx = SVG_MARGIN * need->w;
+	float my = SVG_MARGIN * need->h;
+	SDL_FRect area = (SDL_FRect){ need->x - mx, need->y - my, need->w + 2*mx, need->h + 2*my };
+	area.w = SDL_min( area.w, max_T_size / scale );// it's a window's worth or so, barring huge windows
+	area.h = SDL_min( area.h, max_T_size / scale );
+	area.x = SDL_max( area.x, 0 );
+	area.y = SDL_max( area.y, 0 );
+	area.w = SDL_min( area.w, img_w - area.x );
+	area.h = SDL_min( area.h, img_h - area.y );
+
+	// asking again for what was asked last would only render it again
+	Svg_Render *A = &(V->asked);
+	if( A->bucket == bucket && A->area.x == area.x && A->area.y == area.y && A->area.w == area.w && A->area.h == area.h ){
+		return best;
+	}
+	A->bucket = bucket;
+	A->area = area;
+
+	SDL_LockMutex( V->lock );
+	V->want = *A;
+	V->wanted = true;
+	if( !V->running ){
+		V->running = true;
+		pool_submit( POOL, &(V->job), svg_job, V, 0 );
+	}
+	SDL_UnlockMutex( V->lock );
+	return best;
+}
+
+// a render drawn over its image at DST, placed like render_tiles does its tiles
+void render_svg_over( SDL_Renderer *R, Svg_Render *SV, SDL_FRect *DST, float img_w, double angle, SDL_FlipMode flip, SDL_Color under ){
+
+	float s = DST->w / img_w;
+	float c = SDL_cos( angle * SDL_PI_D / 180.0 );
+	float n = SDL_sin( angle * SDL_PI_D / 180.0 );
+	float Cx = DST->x + 0.5 * DST->w;
+	float Cy = DST->y + 0.5 * DST->h;
+
+	SDL_FRect tr = (SDL_FRect){ DST->x + s * SV->area.x, DST->y + s * SV->area.y, s * SV->area.w, s * SV->area.h };
+	if( flip & SDL_FLIP_HORIZONTAL ) tr.x = DST->x + DST->w - (tr.x - DST->x) - tr.w;
+	if( flip & SDL_FLIP_VERTICAL   ) tr.y = DST->y + DST->h - (tr.y - DST->y) - tr.h;
+	float dx = tr.x + 0.5 * tr.w - Cx;
+	float dy = tr.y + 0.5 * tr.h - Cy;
+	tr.x = Cx + dx*c - dy*n - 0.5 * tr.w;
+	tr.y = Cy + dx*n + dy*c - 0.5 * tr.h;
+
+	// the base raster underneath is blanked out first, its soft edges would show around the sharp ones
+	float aw = tr.w * SDL_fabsf(c) + tr.h * SDL_fabsf(n);
+	float ah = tr.w * SDL_fabsf(n) + tr.h * SDL_fabsf(c);
+	SDL_SetRenderDrawColor( R, under.r, under.g, under.b, under.a );
+	SDL_RenderFillRect( R, &(SDL_FRect){ tr.x + 0.5f * (tr.w - aw), tr.y + 0.5f * (tr.h - ah), aw, ah } );
+
+	if( angle != 0 || flip != SDL_FLIP_NONE ){
+		SDL_RenderTextureRotated( R, SV->TEX, NULL, &tr, angle, NULL, flip );
+	} else {
+		SDL_RenderTexture( R, SV->TEX, NULL, &tr );
+	}
+}
+
+
+/* Small images in a multi-image layout are also copied into shared atlas textures, so all of
+   them go out in a few Quad_Batches rather than one draw each. Shelf packed: an atlas starts over
+   once every image in it is gone, and when they've all filled up with spots of images that left,
+   they're packed again from what's still there. The same goes after the renderer loses them.
+   A white block in each one's corner lets the corner marks go out in the same batch */
+#define ATLAS_SIZE 2048
+#define ATLAS_MAX_IMAGE 512// bigger ones are drawn on their own
+#define MAX_ATLASES 8
+
+typedef struct image_atlas_struct{
+	Quad_Batch batch;// batch.texture is the atlas
+	int size;
+	int x, y, shelf_h;
+	int spots, live;// taken, and still with an image in them
+} Image_Atlas;
+
+Image_Atlas ATLASES [ MAX_ATLASES ];
+int ATLASES_N = 0;
+const SDL_FRect atlas_white = { 1, 1, 2, 2 };// inside the block, clear of its filtered edge
+
+// empty but for the white block
+static void clear_atlas( Image_Atlas *A ){
+	SDL_SetRenderTarget( R, A->batch.texture );
+	SDL_SetRenderDrawColor( R, 0, 0, 0, 0 );
+	SDL_RenderClear( R );
+	SDL_SetRenderDrawColor( R, 255, 255, 255, 255 );
+	SDL_RenderFillRect( R, &(SDL_FRect){ 0, 0, 4, 4 } );
+	SDL_SetRenderTarget( R, NULL );
+	A->x = 4;
+	A->y = 0;
+	A->shelf_h = 4;
+	A->spots = 0;
+	A->live = 0;
+}
+
+static Image_Atlas *new_atlas(){
+
+	if( ATLASES_N >= MAX_ATLASES ) return NULL;
+	int size = SDL_min( ATLAS_SIZE, max_T_size );
+	SDL_Texture *T = SDL_CreateTexture( R, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, size, size );
+	if( T == NULL ){
+		SDL_Log( "no image atlas: %s", SDL_GetError() );
+		return NULL;
+	}
+	SDL_SetTextureBlendMode( T, SDL_BLENDMODE_BLEND );
+
+	Image_Atlas *A = ATLASES + ATLASES_N++;
+	*A = (Image_Atlas){ .batch = { .texture = T, .tex_w = size, .tex_h = size }, .size = size };
+	clear_atlas( A );
+	return A;
+}
+
+void free_atlases(){
+	for (int a = 0; a < ATLASES_N; ++a ){
+		SDL_DestroyTexture( ATLASES[a].batch.texture );
+		free_batch( &(ATLASES[a].batch) );
+	}
+	ATLASES_N = 0;
+}
+
+// gives up img's spot
+static void leave_atlas( Image *img ){
+	Image_Atlas *A = img->ATLAS;
+	if( A == NULL ) return;
+	img->ATLAS = NULL;
+	A->live -= 1;
+	if( A->live == 0 ) clear_atlas( A );
+}
+
+// A is left as it was if it doesn't fit
+static bool atlas_fit( Image_Atlas *A, int w, int h, SDL_Rect *at ){
+	int x = A->x, y = A->y, shelf_h = A->shelf_h;
+	if( x + w > A->size ){// next shelf
+		y += shelf_h;
+		x = 0;
+		shelf_h = 0;
+	}
+	if( w > A->size || y + h > A->size ) return 0;
+	*at = (SDL_Rect){ x, y, w, h };
+	A->x = x + w;
+	A->y = y;
+	A->shelf_h = SDL_max( shelf_h, h );
+	return 1;
+}
+
+// copies every small SIMPLE one that isn't in yet. Main thread only, it renders to the atlases
+void atlas_images( Image *imgs, int len ){
+
+	bool repacked = 0;
+	for (int i = 0; i < len; ++i ){
+		Image *img = imgs + i;
+		if( img->type != SIMPLE || img->ATLAS || img->U.TEXTURE == NULL ) continue;
+		float tw, th;
+		SDL_GetTextureSize( img->U.TEXTURE, &tw, &th );
+		if( tw > ATLAS_MAX_IMAGE || th > ATLAS_MAX_IMAGE ) continue;
+
+		// a pixel of border all round, smeared out from the edge so filtering doesn't bleed in
+		SDL_Rect at;
+		Image_Atlas *A = NULL;
+		for (int a = 0; a < ATLASES_N && !A; ++a ){
+			if( atlas_fit( ATLASES + a, tw + 2, th + 2, &at ) ) A = ATLASES + a;
+		}
+		if( A == NULL ){
+			A = new_atlas();
+			if( A == NULL || !atlas_fit( A, tw + 2, th + 2, &at ) ){
+				bool wasted = 0;
+				for (int a = 0; a < ATLASES_N; ++a ) wasted = wasted || ATLASES[a].spots > ATLASES[a].live;
+				if( repacked || !wasted ) return;
+				// full, but not all of it with what's here now
+				repacked = 1;
+				free_atlases();
+				for (int j = 0; j < len; ++j ) imgs[j].ATLAS = NULL;
+				i = -1;
+				continue;
+			}
+		}
+		SDL_BlendMode mode;
+		SDL_GetTextureBlendMode( img->U.TEXTURE, &mode );
+		SDL_SetTextureBlendMode( img->U.TEXTURE, SDL_BLENDMODE_NONE );
+		SDL_SetRenderTarget( R, A->batch.texture );
+		SDL_RenderTexture( R, img->U.TEXTURE, NULL, &(SDL_FRect){ at.x, at.y, at.w, at.h } );
+		img->ATLAS_SRC = (SDL_FRect){ at.x + 1, at.y + 1, tw, th };
+		SDL_RenderTexture( R, img->U.TEXTURE, NULL, &(img->ATLAS_SRC) );
+		SDL_SetRenderTarget( R, NULL );
+		SDL_SetTextureBlendMode( img->U.TEXTURE, mode );
+		img->ATLAS = A;
+		A->spots += 1;
+		A->live += 1;
+	}
+}
+
+// after the renderer's lost what was in them
+void reload_atlases( Image *imgs, int len ){
+	free_atlases();
+	for (int i = 0; i < len; ++i ) imgs[i].ATLAS = NULL;
+	atlas_images( imgs, len );
+}
+
+typedef struct {
+	SDL_Texture *TEX;
+	Tile_Cache *TILES;
+	SDL_FRect DST;
+	Svg_Render *SVG;// goes over TEX
+	float img_w;// for placing it
+} Loose_Draw;// an image that's drawn on its own
+
+void destroy_Image( Image *img ){
+	switch( img->type ){
+
+		case SIMPLE:
+			SDL_DestroyTexture( img->U.TEXTURE );
+			img->U.TEXTURE = NULL;
+			break;
+
+		case BIG:
+			if( img->U.B.task ){
+				// a tiled image lent its surface to the task, which may still be reading it
+				SDL_Surface *lent = NULL;
+				if( img->U.B.tiles ){
+					lent = img->U.B.tiles->SURF;
+					img->U.B.tiles->SURF = NULL;
+				}
+				cancel_and_destroy_task( img->U.B.task, lent );
+				img->U.B.task = NULL;
+				tasking -= 1;
+			}
+			SDL_DestroyTexture( img->U.B.ORIGINAL );
+			SDL_DestroyTexture( img->U.B.PREVIEW );
+			img->U.B.PREVIEW = NULL;
+			for (int m = 0; m < img->U.B.mip_count; ++m ){
+				SDL_DestroyTexture( img->U.B.MIPS[m] );
+			}
+			img->U.B.mip_count = 0;
+			if( img->U.B.tiles ){
+				destroy_tile_cache( img->U.B.tiles );
+				img->U.B.tiles = NULL;
+			}
+			break;
+
+		case ANIMATION:
+			#ifdef ANIM_STREAMING
+			if( img->U.A.stream ){
+				close_anim_stream( img->U.A.stream );
+				img->U.A.stream = NULL;
+			}
+			#endif
+			SDL_DestroyTexture( img->U.A.TEXTURE );
+			img->U.A.TEXTURE = NULL;
+			for (int f = 0; f < img->U.A.framecount; ++f ){
+				SDL_free( img->U.A.deltas[f].pixels );
+			}
+			SDL_free( img->U.A.deltas );
+			img->U.A.deltas = NULL;
+			break;
+	}
+	if( img->SVG ){
+		close_svg_view( img->SVG );
+		img->SVG = NULL;
+	}
+	img->type = INVALID;
+	SDL_free( img->path );
+	img->path = NULL;
+	leave_atlas( img );
+}
+
+/* modes:
+0 - if it fits, centralize, else force-fit
+1 - centralize
+2 - force fit
+*/
+void calc_transform( Transform *T, SDL_Rect *RCT, int mode ){
+
+	if( mode == 1 || ( mode == 0 && (RCT->w < width && RCT->h < height)) ){// CENTRALIZE IT 
+		T->tx = 0.5 * (width  - RCT->w);
+		T->ty = 0.5 * (height - RCT->h);
+		T->scale_i = 0;
+		T->scale = 1;
+	}
+	else{//                               DOESN'T FIT... FIT IT!
+		SDL_FRect DST = (SDL_FRect){ RCT->x, RCT->y, RCT->w, RCT->h };
+		fit_rect( &DST, &window_rect );
+		T->tx = DST.x; T->ty = DST.y;
+		T->scale = DST.w / (float) RCT->w;
+		T->scale_i = logarithm( 1.1, T->scale );
+		fit = 1;
+	}
+}
+
+
+typedef struct i2d_struct{ int i, j; } i2d;
+
+/* Skyline packing: the tops of everything placed so far, left to right, as spans of constant
+   height. Each image goes wherever it rests lowest, then leftmost, within bin_w.
+   bin_w is picked so the result fills the window as well as it can, like the old anchors did
+   with the aspect ratio. The skyline is kept so a single drop can just go on top */
+#define PACK_GAP 1
+
+typedef struct { int x, y, w; } Sky_Span;
+
+typedef struct {
+	int bin_w;// 0 until something's been packed
+	Sky_Span *spans;
+	int n, cap;
+	int W, H;// what's been covered so far
+	double area;// of what's in, gaps and all
+} Skyline;
+
+Skyline PACKING = {0};
+
+static void skyline_reset( Skyline *S, int bin_w ){
+	if( S->cap == 0 ){
+		S->cap = 64;
+		S->spans = SDL_malloc( S->cap * sizeof(Sky_Span) );
+	}
+	S->bin_w = bin_w;
+	S->spans[0] = (Sky_Span){ 0, 0, bin_w };
+	S->n = 1;
+	S->W = S->H = 0;
+	S->area = 0;
+}
+
+// where a w wide rect starting at span s would rest, -1 if it'd stick out of the bin
+static int skyline_rest( Skyline *S, int s, int w ){
+	int x = S->spans[s].x;
+	if( x + w > S->bin_w ) return -1;
+	int y = 0;
+	for (int k = s; k < S->n && S->spans[k].x < x + w; ++k ){
+		y = SDL_max( y, S->spans[k].y );
+	}
+	return y;
+}
+
+// the new span over [x, x+w) replaces whatever was there, then equal neighbours merge
+static void skyline_raise( Skyline *S, int x, int y, int w ){
+	if( S->n + 2 > S->cap ){
+		S->cap *= 2;
+		S->spans = SDL_realloc( S->spans, S->cap * sizeof(Sky_Span) );
+	}
+	int s = 0;
+	while( S->spans[s].x + S->spans[s].w <= x ) s++;// the first one it covers, they start at the same x
+	SDL_memmove( S->spans + s + 1, S->spans + s, ( S->n - s ) * sizeof(Sky_Span) );
+	S->n++;
+	S->spans[s] = (Sky_Span){ x, y, w };
+	int k = s + 1;
+	while( k < S->n && S->spans[k].x < x + w ){
+		int right = S->spans[k].x + S->spans[k].w;
+		if( right <= x + w ){// swallowed whole
+			SDL_memmove( S->spans + k, S->spans + k + 1, ( S->n - k - 1 ) * sizeof(Sky_Span) );
+			S->n--;
+		}
+		else{
+			S->spans[k].w = right - ( x + w );
+			S->spans[k].x = x + w;
+			break;
+		}
+	}
+	for (int m = SDL_max( 0, s - 1 ); m + 1 < S->n && m <= s; ){
+		if( S->spans[m].y == S->spans[m+1].y ){
+			S->spans[m].w += S->spans[m+1].w;
+			SDL_memmove( S->spans + m + 1, S->spans + m + 2, ( S->n - m - 2 ) * sizeof(Sky_Span) );
+			S->n--;
+		}
+		else m++;
+	}
+}
+
+// false if it's wider than the bin
+static bool skyline_place( Skyline *S, SDL_Rect *r ){
+	int w = r->w + PACK_GAP, h = r->h + PACK_GAP;
+	int best = -1, best_y = 0;
+	for (int s = 0; s < S->n; ++s ){
+		if( best >= 0 && S->spans[s].y >= best_y ) continue;// can't rest any lower than that
+		int y = skyline_rest( S, s, w );
+		if( y >= 0 && ( best < 0 || y < best_y ) ){
+			best = s;
+			best_y = y;
+		}
+	}
+	if( best < 0 ) return 0;
+	r->x = S->spans[best].x;
+	r->y = best_y;
+	skyline_raise( S, r->x, best_y + h, w );
+	S->W = SDL_max( S->W, r->x + r->w );
+	S->H = SDL_max( S->H, r->y + r->h );
+	S->area += w * (double) h;
+	return 1;
+}
+
+// how far W × H has to be shrunk to fit the window, the smaller the better
+static double pack_fit( int W, int H ){
+	return SDL_max( W / (double) width, H / (double) height );
+}
+
+static Image *pack_sorting;// for the sort
+
+static int compare_pack( const void *a, const void *b ){
+	SDL_Rect *A = &( pack_sorting[ *(const int*) a ].RCT );
+	SDL_Rect *B = &( pack_sorting[ *(const int*) b ].RCT );
+	if( A->h != B->h ) return B->h - A->h;// tallest first
+	return B->w - A->w;
+}
+
+static void pack_into( Skyline *S, Image *imgs, int *ids, int len, int bin_w ){
+	skyline_reset( S, bin_w );
+	for (int i = 0; i < len; ++i ) skyline_place( S, &(imgs[ ids[i] ].RCT) );
+}
+
+i2d pack_imgs( Image *imgs, int len ){
+
+	if( len == 0 ) return (i2d){ 0, 0 };
+	int *ids = SDL_malloc( len * sizeof(int) );
+	double area = 0;
+	int widest = 0;
+	for (int i = 0; i < len; ++i ){
+		ids[i] = i;
+		area += ( imgs[i].RCT.w + PACK_GAP ) * (double)( imgs[i].RCT.h + PACK_GAP );
+		widest = SDL_max( widest, imgs[i].RCT.w + PACK_GAP );
+	}
+	pack_sorting = imgs;
+	SDL_qsort( ids, len, sizeof(int), compare_pack );
+
+	// a few bin widths around the one that would come out the window's shape if it packed perfectly
+	const float tries [] = { 0.8, 0.9, 1.0, 1.1, 1.25, 1.5 };
+	double ideal = SDL_sqrt( area * width / height );
+	int best_w = 0;
+	double best_fit = 0;
+	for (int t = 0; t < (int) SDL_arraysize( tries ); ++t ){
+		int bin_w = SDL_max( widest, (int)( tries[t] * ideal ) );
+		pack_into( &PACKING, imgs, ids, len, bin_w );
+		double fit = pack_fit( PACKING.W, PACKING.H );
+		if( best_w == 0 || fit < best_fit ){
+			best_w = bin_w;
+			best_fit = fit;
+		}
+	}
+	pack_into( &PACKING, imgs, ids, len, best_w );
+	SDL_free( ids );
+	return (i2d){ PACKING.W, PACKING.H };
+}
+
+/* imgs[len-1] just came in: it goes on top of the current packing, so nothing else moves, unless
+   that leaves the whole lot fitting the window much worse than a fresh pack would */
+i2d pack_one_more( Image *imgs, int len ){
+
+	SDL_Rect *r = &( imgs[len-1].RCT );
+	if( PACKING.bin_w == 0 || !skyline_place( &PACKING, r ) ) return pack_imgs( imgs, len );
+
+	double ideal = SDL_sqrt( PACKING.area / ( width * (double) height ) );
+	if( pack_fit( PACKING.W, PACKING.H ) > 1.5 * ideal ) return pack_imgs( imgs, len );
+	return (i2d){ PACKING.W, PACKING.H };
+}
+
+void free_packing(){
+	SDL_free( PACKING.spans );
+	PACKING = (Skyline){0};
+}
+
+/* A uniform grid over the packed RCTs, so a frame only has to look at the images near the
+   window. Each image is listed in every cell it covers, cells are about an average image big */
+typedef struct {
+	int n;// how many images it was built over
+	float cell;
+	int cols, rows;
+	int *start;// cols*rows + 1 offsets into items
+	int *items;
+	int skew;// how far a quarter turn can take an image outside its RCT
+	Uint32 *seen;// per image, so ones in several cells only come up once a query
+	Uint32 stamp;
+	int *visible;
+} Layout_Index;
+
+void free_layout_index( Layout_Index *L ){
+	SDL_free( L->start );
+	SDL_free( L->items );
+	SDL_free( L->seen );
+	SDL_free( L->visible );
+	SDL_memset( L, 0, sizeof(Layout_Index) );
+}
+
+static void layout_cells( Layout_Index *L, SDL_Rect *r, int *c0, int *r0, int *c1, int *r1 ){
+	*c0 = SDL_clamp( (int)( r->x / L->cell ), 0, L->cols-1 );
+	*r0 = SDL_clamp( (int)( r->y / L->cell ), 0, L->rows-1 );
+	*c1 = SDL_clamp( (int)( ( r->x + r->w ) / L->cell ), 0, L->cols-1 );
+	*r1 = SDL_clamp( (int)( ( r->y + r->h ) / L->cell ), 0, L->rows-1 );
+}
+
+// after pack_imgs(), W × H being what it returned
+void index_layout( Layout_Index *L, Image *imgs, int len, int W, int H ){
+
+	free_layout_index( L );
+	if( len == 0 ) return;
+	L->n = len;
+	L->cell = SDL_max( 16, SDL_sqrtf( W * (float) H / len ) );
+	L->cols = SDL_clamp( (int)( W / L->cell ) + 1, 1, 1024 );
+	L->rows = SDL_clamp( (int)( H / L->cell ) + 1, 1, 1024 );
+	L->cell = SDL_max( W / (float) L->cols, H / (float) L->rows ) + 1;
+	L->start = SDL_calloc( L->cols * L->rows + 1, sizeof(int) );
+	L->seen = SDL_calloc( len, sizeof(Uint32) );
+	L->visible = SDL_malloc( len * sizeof(int) );
+
+	// counted, summed into offsets, then filled in
+	int c0, r0, c1, r1;
+	for (int i = 0; i < len; ++i ){
+		layout_cells( L, &(imgs[i].RCT), &c0, &r0, &c1, &r1 );
+		for (int r = r0; r <= r1; ++r ){
+			for (int c = c0; c <= c1; ++c ) L->start[ r * L->cols + c + 1 ] += 1;
+		}
+		L->skew = SDL_max( L->skew, ( SDL_abs( imgs[i].RCT.w - imgs[i].RCT.h ) + 1 ) / 2 );
+	}
+	for (int k = 0; k < L->cols * L->rows; ++k ) L->start[k+1] += L->start[k];
+	L->items = SDL_malloc( L->start[ L->cols * L->rows ] * sizeof(int) );
+	int *fill = SDL_malloc( L->cols * L->rows * sizeof(int) );
+	SDL_memcpy( fill, L->start, L->cols * L->rows * sizeof(int) );
+	for (int i = 0; i < len; ++i ){
+		layout_cells( L, &(imgs[i].RCT), &c0, &r0, &c1, &r1 );
+		for (int r = r0; r <= r1; ++r ){
+			for (int c = c0; c <= c1; ++c ) L->items[ fill[ r * L->cols + c ]++ ] = i;
+		}
+	}
+	SDL_free( fill );
+}
+
+/* The images whose RCT, quarter turned if turned is set, meets area (in layout coordinates),
+   in L->visible. Returns how many */
+int query_layout( Layout_Index *L, Image *imgs, SDL_FRect *area, bool turned ){
+
+	if( ++L->stamp == 0 ){// wrapped around
+		SDL_memset( L->seen, 0, L->n * sizeof(Uint32) );
+		L->stamp = 1;
+	}
+	SDL_Rect A = (SDL_Rect){ SDL_floorf( area->x ), SDL_floorf( area->y ), SDL_ceilf( area->w ) + 1, SDL_ceilf( area->h ) + 1 };
+	int pad = turned? L->skew : 0;// a turned image can reach into area from cells outside it
+	SDL_Rect reach = (SDL_Rect){ A.x - pad, A.y - pad, A.w + 2*pad, A.h + 2*pad };
+	int c0, r0, c1, r1;
+	layout_cells( L, &reach, &c0, &r0, &c1, &r1 );
+
+	int count = 0;
+	for (int r = r0; r <= r1; ++r ){
+		for (int c = c0; c <= c1; ++c ){
+			int k = r * L->cols + c;
+			for (int t = L->start[k]; t < L->start[k+1]; ++t ){
+				int i = L->items[t];
+				if( L->seen[i] == L->stamp ) continue;
+				L->seen[i] = L->stamp;
+				SDL_Rect B = imgs[i].RCT;
+				if( turned ){
+					int d = ( B.w - B.h ) / 2;
+					B = (SDL_Rect){ B.x + d, B.y - d, B.h, B.w };
+				}
+				if( SDL_HasRectIntersection( &A, &B ) ) L->visible[ count++ ] = i;
+			}
+		}
+	}
+	return count;
+}
+
+
+// full path of a directory_list entry
+void entry_path( char *path, size_t len, const char *entry ){
+	if( remote_operation ){
+		SDL_snprintf( path, len, "%s%s", folderpath, entry );
+	} else {
+		SDL_strlcpy( path, entry, len );
+	}
+}
+
+
+/* The last few images stepped away from, textures and all, so going back to one of them is free.
+   Keyed by path plus the file's size and mtime, so one that was edited meanwhile gets reloaded.
+   Only touched from the main thread. Past `budget` bytes the least recently used go first. */
+#define RECENT_SLOTS 32
+
+typedef struct {
+	Image img;// type INVALID is a free slot
+	size_t bytes;
+	Uint64 last_used;
+} Recent_Entry;
+
+typedef struct {
+	Recent_Entry entries [ RECENT_SLOTS ];
+	size_t bytes, budget;
+	Uint64 clock;
+	int hits, misses;
+} Recent_Images;
+
+Recent_Images RECENT;
+
+void init_recent_images( size_t budget ){
+	SDL_memset( &RECENT, 0, sizeof(Recent_Images) );
+	RECENT.budget = budget;
+}
+
+static size_t texture_bytes( SDL_Texture *T ){
+	float fw, fh;
+	if( T == NULL || !SDL_GetTextureSize( T, &fw, &fh ) ) return 0;
+	return 4 * (size_t) fw * (size_t) fh;
+}
+
+static size_t image_bytes( Image *img ){
+	size_t bytes = 0;
+	switch( img->type ){
+		case SIMPLE:
+			bytes = texture_bytes( img->U.TEXTURE );
+			if( img->SVG ) bytes += svg_view_bytes( img->SVG );
+			break;
+		case BIG:
+			bytes = texture_bytes( img->U.B.ORIGINAL );
+			for (int m = 0; m < img->U.B.mip_count; ++m ) bytes += texture_bytes( img->U.B.MIPS[m] );
+			if( img->U.B.tiles ){
+				SDL_Surface *S = img->U.B.tiles->SURF;
+				bytes += (size_t) S->pitch * S->h;
+				bytes += (size_t) img->U.B.tiles->resident_n * 4 * img->U.B.tiles->ts * img->U.B.tiles->ts;
+			}
+			break;
+		case ANIMATION:
+			bytes = texture_bytes( img->U.A.TEXTURE ) + img->U.A.bytes;
+			break;
+	}
+	return bytes;
+}
+
+static void drop_recent( Recent_Entry *e ){
+	RECENT.bytes -= e->bytes;
+	destroy_Image( &(e->img) );
+	SDL_memset( e, 0, sizeof(Recent_Entry) );
+}
+
+void forget_recent_images(){
+	for (int i = 0; i < RECENT_SLOTS; ++i ){
+		if( RECENT.entries[i].img.type != INVALID ) drop_recent( RECENT.entries + i );
+	}
+}
+
+void deinit_recent_images(){
+	forget_recent_images();
+	SDL_Log( "recent images: %d hits, %d misses", RECENT.hits, RECENT.misses );
+}
+
+/* Takes img off the caller's hands, it's left INVALID either way.
+   Half-built mip pyramids aren't worth keeping, those are just destroyed */
+void retire_image( Image *img ){
+
+	if( img->type == INVALID ) return;
+
+	size_t bytes = image_bytes( img );
+	if( img->path == NULL || (img->type == BIG && img->U.B.task) || (img->type == ANIMATION && img->U.A.stream)
+	 || bytes > RECENT.budget ){
+		destroy_Image( img );
+		return;
+	}
+
+	while( 1 ){
+		Recent_Entry *lru = NULL;
+		Recent_Entry *free_slot = NULL;
+		for (int i = 0; i < RECENT_SLOTS; ++i ){
+			Recent_Entry *e = RECENT.entries + i;
+			if( e->img.type == INVALID ){
+				if( !free_slot ) free_slot = e;
+			}
+			else if( !lru || e->last_used < lru->last_used ) lru = e;
+		}
+		if( free_slot && RECENT.bytes + bytes <= RECENT.budget ){
+			leave_atlas( img );// it's packed in again if it comes back
+			if( img->SVG ) idle_svg_view( img->SVG );// nothing in the cache may still be running
+			free_slot->img = *img;
+			free_slot->bytes = bytes;
+			free_slot->last_used = ++RECENT.clock;
+			RECENT.bytes += bytes;
+			SDL_memset( img, 0, sizeof(Image) );
+			return;
+		}
+		drop_recent( lru );
+	}
+}
+
+static Recent_Entry *find_recent( const char *path ){
+	for (int i = 0; i < RECENT_SLOTS; ++i ){
+		Recent_Entry *e = RECENT.entries + i;
+		if( e->img.type != INVALID && SDL_strcmp( e->img.path, path ) == 0 ) return e;
+	}
+	return NULL;
+}
+
+bool is_recent( const char *path ){
+	return find_recent( path ) != NULL;
+}
+
+// moves the image for path into out, if it's still the same file as when it was loaded
+bool take_recent( const char *path, SDL_PathInfo *info, Image *out ){
+	Recent_Entry *e = find_recent( path );
+	if( e && ( e->img.fsize != info->size || e->img.mtime != info->modify_time ) ){
+		drop_recent( e );// stale
+		e = NULL;
+	}
+	if( e == NULL ){
+		RECENT.misses += 1;
+		return 0;
+	}
+	RECENT.hits += 1;
+	*out = e->img;
+	RECENT.bytes -= e->bytes;
+	SDL_memset( e, 0, sizeof(Recent_Entry) );
+	return 1;
+}
+
+
+/* Decodes the entries around INDEX on the worker pool while the current one is being looked at,
+   so stepping onto them only costs the texture upload. Decoded surfaces are capped at `budget`
+   bytes, the ones furthest from INDEX make way for closer ones. */
+#define PREFETCH_AHEAD 2 // on each side
+#define PREFETCH_SLOTS ( 4 * PREFETCH_AHEAD )
+
+typedef struct {
+	int id;// 0 is a free slot
+	int rank;// 1 is right next to INDEX, bigger is further away
+	char path [1024];
+	SDL_Surface *SURF;// once decoded
+	size_t bytes;
+} Prefetch_Entry;
+
+typedef struct {
+	SDL_Mutex *lock;
+	Prefetch_Entry entries [ PREFETCH_SLOTS ];
+	size_t bytes, budget;
+	int next_id;
+} Prefetcher;
+
+Prefetcher PREFETCH;
+
+void init_prefetcher( size_t budget ){
+	SDL_memset( &PREFETCH, 0, sizeof(Prefetcher) );
+	PREFETCH.lock = SDL_CreateMutex();
+	PREFETCH.budget = budget;
+}
+
+// with PREFETCH.lock held. a job still decoding for it will find it gone and drop its result
+static void drop_prefetched( Prefetch_Entry *e ){
+	if( e->SURF ){
+		SDL_DestroySurface( e->SURF );
+		PREFETCH.bytes -= e->bytes;
+	}
+	SDL_memset( e, 0, sizeof(Prefetch_Entry) );
+}
+
+// jobs still to come for them will find nothing to do
+void forget_prefetched(){
+	SDL_LockMutex( PREFETCH.lock );
+	for (int i = 0; i < PREFETCH_SLOTS; ++i ){
+		drop_prefetched( PREFETCH.entries + i );
+	}
+	SDL_UnlockMutex( PREFETCH.lock );
+}
+
+// only once nothing else can run on the pool
+void deinit_prefetcher(){
+	for (int i = 0; i < PREFETCH_SLOTS; ++i ){
+		drop_prefetched( PREFETCH.entries + i );
+	}
+	SDL_DestroyMutex( PREFETCH.lock );
+}
+
+static Prefetch_Entry *find_prefetched( int id, const char *path ){
+	for (int i = 0; i < PREFETCH_SLOTS; ++i ){
+		Prefetch_Entry *e = PREFETCH.entries + i;
+		if( e->id == 0 ) continue;
+		if( id ? e->id == id : SDL_strcmp( e->path, path ) == 0 ) return e;
+	}
+	return NULL;
+}
+
+static void prefetch_job( void *data, int id ){
+	(void) data;
+
+	char path [1024];
+	SDL_LockMutex( PREFETCH.lock );
+	Prefetch_Entry *e = find_prefetched( id, NULL );
+	if( e ){
+		SDL_strlcpy( path, e->path, 1024 );
+	}
+	SDL_UnlockMutex( PREFETCH.lock );
+	if( e == NULL ) return;
+
+	SDL_Surface *S = IMG_Load( path );
+
+	SDL_LockMutex( PREFETCH.lock );
+	e = find_prefetched( id, NULL );
+	if( e ){
+		size_t bytes = S? (size_t) S->pitch * S->h : 0;
+		while( S && PREFETCH.bytes + bytes > PREFETCH.budget ){
+			Prefetch_Entry *victim = NULL;
+			for (int i = 0; i < PREFETCH_SLOTS; ++i ){
+				Prefetch_Entry *v = PREFETCH.entries + i;
+				if( v->SURF && v->rank > e->rank && (!victim || v->rank > victim->rank) ) victim = v;
+			}
+			if( victim == NULL ) break;
+			drop_prefetched( victim );
+		}
+		if( S && PREFETCH.bytes + bytes <= PREFETCH.budget ){
+			e->SURF = S;
+			e->bytes = bytes;
+			PREFETCH.bytes += bytes;
+			S = NULL;
+		}
+		else drop_prefetched( e );
+	}
+	SDL_UnlockMutex( PREFETCH.lock );
+
+	if( S ) SDL_DestroySurface( S );
+}
+
+// animations and svgs have their own loaders, the rest go through IMG_Load
+static bool prefetchable( char *path ){
+	int EXT = check_extension( path );
+	return EXT && EXT != 4 && EXT != 9 && EXT != 10;
+}
+
+// forgets whatever isn't around index anymore and starts decoding what's new
+void prefetch_around( str_vec *list, int index ){
+
+	int count = ok_vec_count( list );
+	char path [1024];
+
+	SDL_LockMutex( PREFETCH.lock );
+
+	for (int i = 0; i < PREFETCH_SLOTS; ++i ) PREFETCH.entries[i].rank = 0;
+
+	for (int d = 1; d <= PREFETCH_AHEAD && count > 1; ++d ){
+		for (int s = 1; s >= -1; s -= 2 ){
+			int i = ( (index + s*d) % count + count ) % count;
+			if( i == index ) continue;
+			entry_path( path, 1024, ok_vec_get( list, i ) );
+			if( !prefetchable( path ) || is_recent( path ) ) continue;
+
+			int rank = (s > 0)? 2*d - 1 : 2*d;
+			Prefetch_Entry *e = find_prefetched( 0, path );
+			if( e ){
+				if( e->rank == 0 || rank < e->rank ) e->rank = rank;
+				continue;
+			}
+			for (int f = 0; f < PREFETCH_SLOTS; ++f ){
+				if( PREFETCH.entries[f].id != 0 ) continue;
+				e = PREFETCH.entries + f;
+				e->id = ++PREFETCH.next_id;
+				e->rank = rank;
+				SDL_strlcpy( e->path, path, 1024 );
+				pool_submit( POOL, NULL, prefetch_job, NULL, e->id );
+				break;
+			}
+		}
+	}
+
+	for (int i = 0; i < PREFETCH_SLOTS; ++i ){
+		if( PREFETCH.entries[i].id && PREFETCH.entries[i].rank == 0 ){
+			drop_prefetched( PREFETCH.entries + i );
+		}
+	}
+	SDL_UnlockMutex( PREFETCH.lock );
+}
+
+/* Hands over the decoded surface for path, if it was prefetched. One that's still being decoded
+   is given up on rather than waited for, however far along it is: the caller decodes it itself
+   and a huge neighbour can't hold up the main thread or a worker. */
+SDL_Surface *take_prefetched( const char *path ){
+	SDL_Surface *S = NULL;
+	SDL_LockMutex( PREFETCH.lock );
+	Prefetch_Entry *e = find_prefetched( 0, path );
+	if( e ){
+		S = e->SURF;
+		e->SURF = NULL;
+		PREFETCH.bytes -= e->bytes;
+		drop_prefetched( e );
+	}
+	SDL_UnlockMutex( PREFETCH.lock );
+	return S;
+}
+
+
+Image *IMAGES = NULL;
+int IMAGES_N = 0;
+
+/* small ones get crisp scaling, ones that don't fit the window get a mip pyramid.
+   SURF is what the texture was made from, if it's at hand, so the mips needn't decode it again.
+   It's taken either way */
+static void settle_texture( char *path, int EXT, Image *out, SDL_Surface *SURF ){
+
+	float fw, fh;
+	SDL_GetTextureSize( out->U.TEXTURE, &fw, &fh );
+	out->RCT = (SDL_Rect){ 0, 0, fw, fh };
+
+	if( antialiasing > 0 && (out->RCT.w <= 256 || out->RCT.h <= 256) ){
+		antialiasing = SDL_SCALEMODE_NEAREST;//SDL_SCALEMODE_PIXELART;
+		SDL_SetTextureScaleMode( out->U.TEXTURE, antialiasing );
+	}
+
+	if( (fw > width || fh > height) && EXT != 10 ){
+		out->type = BIG;
+		out->U.B.mip_count = 0;
+		out->U.B.tiles = NULL;
+		out->U.B.PREVIEW = NULL;
+		out->U.B.task = launch_mip_task( path, SURF, true, width, height, 1.25 );
+		tasking += 1;
+	}
+	else SDL_DestroySurface( SURF );
+}
+
+// makes out from a decoded surface, which it takes. Uploads, so it's main thread only
+static int image_from_surface( char *path, int EXT, SDL_Surface *SURF, Image *out ){
+
+	if( SURF->w > max_T_size || SURF->h > max_T_size ){ // Too big.... break it up into tiles
+		if( SURF->format != SDL_PIXELFORMAT_RGBA32 ){
+			SDL_Surface *conv = SDL_ConvertSurface( SURF, SDL_PIXELFORMAT_RGBA32 );
+			SDL_DestroySurface( SURF );
+			SURF = conv;
+			if( SURF == NULL ){
+				SDL_snprintf( buffer, bufflen, "ERROR: %s", SDL_GetError() );
+				SDL_SetWindowTitle( window, buffer );
+				return 0;
+			}
+		}
+		out->type = BIG;
+		out->RCT = (SDL_Rect){ 0, 0, SURF->w, SURF->h };
+		out->U.B.ORIGINAL = NULL;
+		out->U.B.mip_count = 0;
+		out->U.B.tiles = create_tile_cache( SURF );
+		out->U.B.PREVIEW = NULL;
+		out->U.B.task = launch_mip_task( path, SURF, false, width, height, 1.25 );
+		tasking += 1;
+		return 1;
+	}
+
+	out->U.TEXTURE = SDL_CreateTextureFromSurface( R, SURF );
+	if( out->U.TEXTURE == NULL ){
+		SDL_Log( "bad texture: %s\n", SDL_GetError() );
+		SDL_snprintf( buffer, bufflen, "ERROR: %s", SDL_GetError() );
+		SDL_SetWindowTitle( window, buffer );
+		SDL_DestroySurface( SURF );
+		out->type = INVALID;
+		return 0;
+	}
+	out->type = SIMPLE;
+	settle_texture( path, EXT, out, SURF );
+	return 1;
+}
+
+static int decode_image( char *path, int EXT, Image *out ){
+
+	SDL_Surface *SURF = NULL;// decoded here rather than by IMG_LoadTexture, so the mips can have it too
+
+	if( EXT == 4 || EXT == 9 ){//.gif or webp
+		#ifdef ANIM_STREAMING
+		if( !open_animation( path, out ) ){
+			SDL_Log("bad anim, %s\n", SDL_GetError() );
+			goto loadtexture;
+		}
+		#else
+		IMG_Animation *ANIM = IMG_LoadAnimation( path );
+
+		if( ANIM == NULL ){
+			SDL_Log("bad anim, %s\n", SDL_GetError() );
+			goto loadtexture;
+		}
+		else{
+			if( ANIM->count == 1 ){
+				out->U.TEXTURE = SDL_CreateTextureFromSurface( R,  ANIM->frames[0] );
+				out->type = SIMPLE;
+			}
+			else{
+				SDL_Log( "good anim, %d frames\n", ANIM->count );
+				process_animation( out, ANIM );
+				animating = 1;
+			}
+			IMG_FreeAnimation( ANIM );
+		}
+		#endif
+	}
+	else if( EXT == 10 ){//.svg
+
+		plutosvg_document_t* doc = plutosvg_document_load_from_file( path, 1, 1 );//width, height
+		if (!doc) {
+		    SDL_Log( "Failed to load SVG file: %s\n", path );
+		    return 0;
+		}
+		plutovg_rect_t bounds;
+		plutosvg_document_extents( doc, NULL, &bounds );
+		//SDL_Log( "\n%g,%g,%g,%g", bounds.x, bounds.y, bounds.w, bounds.h );
+
+		SDL_Surface* sdl_surface = rasterize_svg( doc, &bounds, &(SDL_FRect){ 0, 0, bounds.w, bounds.h }, 1 );
+		//IMG_SavePNG( sdl_surface, "output.png" );
+		if( sdl_surface == NULL ){
+			SDL_Log( "ERROR converting plutosvg surf to SDL: %s", SDL_GetError() );
+			plutosvg_document_destroy( doc );
+		}
+		else{
+		    out->U.TEXTURE = SDL_CreateTextureFromSurface( R, sdl_surface );
+		    out->type = SIMPLE;
+		    out->SVG = open_svg_view( doc, bounds );// kept for the zoomed in renders
+		}
+
+	    SDL_DestroySurface(sdl_surface); 
+	}
+	else{
+		loadtexture:
+		SURF = take_prefetched( path );
+		if( SURF == NULL ) SURF = IMG_Load( path );
+		if( SURF == NULL ) goto bad_surface;
+	}
+
+	if( SURF == NULL && ( out->type == INVALID || (out->type == SIMPLE && out->U.TEXTURE == NULL) ) ){
+		SDL_Log("bad texture: %s\n", SDL_GetError());
+		
+		SURF = IMG_Load( path );
+
+		if( SURF == NULL ){
+			bad_surface:
+			SDL_Log( "bad surface" );
+			SDL_snprintf( buffer, bufflen, "ERROR: %s", SDL_GetError() );
+			SDL_SetWindowTitle( window, buffer );
+			return 0;
+		}
+	}
+	if( SURF ) return image_from_surface( path, EXT, SURF, out );
+	
+	if( out->type == SIMPLE ) settle_texture( path, EXT, out, NULL );
+
+	return 1;
+}
+
+// out's previous image goes to the recent cache, where the new one might be coming from
+int load_image( char *path, Image *out ){
+
+	int EXT = check_extension( path );
+
+	if( !EXT ) return 0;
+
+	retire_image( out );
+
+	SDL_PathInfo info;
+	if( !SDL_GetPathInfo( path, &info ) ) SDL_memset( &info, 0, sizeof(SDL_PathInfo) );
+
+	if( take_recent( path, &info, out ) ){
+		if( out->type == ANIMATION ){
+			out->U.A.NFRAME = SDL_GetTicksNS() + SDL_MS_TO_NS( out->U.A.deltas[ out->U.A.FRAME ].delay );
+			out->U.A.SHOWN = -1;
+			animating = 1;
+		}
+		return 1;
+	}
+
+	int is = decode_image( path, EXT, out );
+	if( is ){
+		out->path = SDL_strdup( path );
+		out->fsize = info.size;
+		out->mtime = info.modify_time;
+	}
+	return is;
+}
+
+/* after the renderer's lost every texture, the ones in the recent cache too. Each image is
+   decoded again from its file, ones without one are left for their loads to replace */
+void reload_images( Image *imgs, int len ){
+	forget_recent_images();
+	for (int i = 0; i < len; ++i ){
+		if( imgs[i].path == NULL ) continue;
+		char *path = imgs[i].path;
+		imgs[i].path = NULL;
+		destroy_Image( imgs + i );
+		if( !load_image( path, imgs + i ) ) SDL_Log( "couldn't reload %s", path );
+		SDL_free( path );
+	}
+	reload_atlases( imgs, len );
+}
+
+
+/* Navigation loads don't block the event loop: the file is read and decoded on the worker pool,
+   the result comes back through LOADED and the texture gets made on the main thread.
+   Every request bumps load_generation, anything older bails out between stages,
+   and whatever of it still makes it into LOADED is thrown away there. */
+#define LOAD_PENDING -1
+#define LOAD_REFINED 3// the full decode took over from a preview, same size so the view stays
+
+typedef struct {
+	int generation;
+	char path [1024];
+	Uint64 fsize;
+	SDL_Time mtime;
+	int fit_w, fit_h;// the window, when it was requested
+	SDL_Surface *SURF;// NULL if it couldn't be read or decoded
+	bool preview;// SURF is a reduced decode standing in for w × h
+	int w, h;
+} Load_Request;
+
+typedef struct ok_queue_of( Load_Request* ) load_queue;
+
+load_queue LOADED = OK_QUEUE_INIT;
+SDL_AtomicInt load_generation;
+
+static bool load_superseded( Load_Request *L ){
+	return SDL_GetAtomicInt( &load_generation ) != L->generation;
+}
+
+#ifdef USE_LIBJPEG
+/* libjpeg can do the IDCT at 1/2, 1/4 or 1/8 scale, which skips most of the decoding work.
+   For a camera original on a normal screen that's a preview in a fraction of the full decode.
+   NULL when it wouldn't save much, or libjpeg can't do it */
+typedef struct {
+	struct jpeg_error_mgr pub;
+	jmp_buf escape;
+} jpeg_escape;
+
+static void jpeg_bail( j_common_ptr cinfo ){
+	longjmp( ((jpeg_escape*) cinfo->err)->escape, 1 );
+}
+
+static SDL_Surface *jpeg_preview( const void *bytes, size_t len, int fit_w, int fit_h, int *full_w, int *full_h ){
+
+	struct jpeg_decompress_struct cinfo;
+	jpeg_escape err;
+	SDL_Surface *volatile S = NULL;
+
+	cinfo.err = jpeg_std_error( &err.pub );
+	err.pub.error_exit = jpeg_bail;
+	if( setjmp( err.escape ) ){
+		jpeg_destroy_decompress( &cinfo );
+		SDL_DestroySurface( S );
+		return NULL;
+	}
+	jpeg_create_decompress( &cinfo );
+	jpeg_mem_src( &cinfo, (const unsigned char*) bytes, len );
+	jpeg_read_header( &cinfo, TRUE );
+
+	*full_w = cinfo.image_width;
+	*full_h = cinfo.image_height;
+	float fit = SDL_min( fit_w / (float) cinfo.image_width, fit_h / (float) cinfo.image_height );
+	int denom = 1;// a preview down to 3/4 of the size it'll be drawn at is fine
+	while( denom < 8 && 2 * denom * fit * 0.75f <= 1 ) denom *= 2;
+
+	// at 1/2 it's hardly quicker than the full decode, which would only come in later for it
+	if( denom < 4 || ( cinfo.jpeg_color_space != JCS_YCbCr && cinfo.jpeg_color_space != JCS_GRAYSCALE ) ){
+		jpeg_destroy_decompress( &cinfo );
+		return NULL;
+	}
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = denom;
+	cinfo.dct_method = JDCT_IFAST;
+	cinfo.do_fancy_upsampling = FALSE;
+#ifdef JCS_EXTENSIONS // libjpeg-turbo
+	cinfo.out_color_space = JCS_EXT_RGBA;
+	SDL_PixelFormat format = SDL_PIXELFORMAT_RGBA32;
+#else
+	cinfo.out_color_space = JCS_RGB;
+	SDL_PixelFormat format = SDL_PIXELFORMAT_RGB24;
+#endif
+	jpeg_start_decompress( &cinfo );
+
+	S = SDL_CreateSurface( cinfo.output_width, cinfo.output_height, format );
+	if( S == NULL ){
+		jpeg_destroy_decompress( &cinfo );
+		return NULL;
+	}
+	while( cinfo.output_scanline < cinfo.output_height ){
+		JSAMPROW row = (Uint8*) S->pixels + cinfo.output_scanline * S->pitch;
+		jpeg_read_scanlines( &cinfo, &row, 1 );
+	}
+	jpeg_finish_decompress( &cinfo );
+	jpeg_destroy_decompress( &cinfo );
+	return S;
+}
+#endif
+
+// S goes up stretched over w × h until L itself comes in
+static void push_preview( Load_Request *L, SDL_Surface *S, int w, int h ){
+	Load_Request *P = SDL_malloc( sizeof(Load_Request) );
+	*P = *L;
+	P->SURF = S;
+	P->preview = 1;
+	P->w = w;
+	P->h = h;
+	ok_queue_push( &LOADED, P );
+	wake_main();
+}
+
+static void load_job( void *data, int index ){
+	(void) index;
+
+	Load_Request *L = data;
+
+	if( load_superseded( L ) ) goto cancelled;
+
+	L->SURF = take_prefetched( L->path );
+	if( L->SURF == NULL ){
+		// a big one that's been seen before has its window-fit version on disk
+		int full_w, full_h;
+		SDL_Surface *thumb = load_thumb( L->path, L->fsize, L->mtime, &full_w, &full_h );
+		if( thumb ) push_preview( L, thumb, full_w, full_h );
+
+		size_t len;
+		void *bytes = SDL_LoadFile( L->path, &len );
+		if( bytes == NULL ){
+			SDL_Log( "couldn't read %s: %s", L->path, SDL_GetError() );
+		}
+		else if( load_superseded( L ) ){
+			SDL_free( bytes );
+			goto cancelled;
+		}
+		else{
+			#ifdef USE_LIBJPEG
+			int EXT = check_extension( L->path );
+			if( thumb == NULL && ( EXT == 2 || EXT == 3 ) ){
+				SDL_Surface *P = jpeg_preview( bytes, len, L->fit_w, L->fit_h, &full_w, &full_h );
+				if( P ) push_preview( L, P, full_w, full_h );
+				if( load_superseded( L ) ){
+					SDL_free( bytes );
+					goto cancelled;
+				}
+			}
+			#endif
+			const char *ext = SDL_strrchr( L->path, '.' );
+			L->SURF = IMG_LoadTyped_IO( SDL_IOFromConstMem( bytes, len ), true, ext? ext+1 : NULL );
+			SDL_free( bytes );
+			if( L->SURF == NULL ) SDL_Log( "bad surface: %s", SDL_GetError() );
+		}
+	}
+	ok_queue_push( &LOADED, L );
+	wake_main();
+	return;
+
+	cancelled:
+	SDL_free( L );
+}
+
+/* Starts loading path into out. Recently viewed images, animations and svgs are done right here
+   and it returns what load_image() would, otherwise it's LOAD_PENDING until finish_load() */
+int request_image( char *path, Image *out ){
+
+	int EXT = check_extension( path );
+	if( !EXT ) return 0;
+
+	int generation = SDL_AddAtomicInt( &load_generation, 1 ) + 1;
+
+	if( !prefetchable( path ) || is_recent( path ) ) return load_image( path, out );
+
+	Load_Request *L = SDL_calloc( 1, sizeof(Load_Request) );
+	L->generation = generation;
+	SDL_strlcpy( L->path, path, 1024 );
+	L->fit_w = width;
+	L->fit_h = height;
+	SDL_PathInfo info;
+	if( SDL_GetPathInfo( path, &info ) ){
+		L->fsize = info.size;
+		L->mtime = info.modify_time;
+	}
+	pool_submit( POOL, NULL, load_job, L, 0 );
+	return LOAD_PENDING;
+}
+
+/* Takes L back from LOADED and, if it's still the latest request, swaps it into out.
+   LOAD_PENDING if it was superseded, LOAD_REFINED if it replaced its own preview,
+   otherwise what load_image() would return */
+int finish_load( Load_Request *L, Image *out ){
+
+	static int previewed = 0;// generation whose preview is up
+	int is = LOAD_PENDING;
+	if( load_superseded( L ) ){
+		if( L->SURF ) SDL_DestroySurface( L->SURF );
+	}
+	else if( L->SURF == NULL ){
+		SDL_snprintf( buffer, bufflen, "ERROR: couldn't load \"%s\"", L->path );
+		SDL_SetWindowTitle( window, buffer );
+		is = 0;
+	}
+	else if( L->preview ){// stretched over the full size until the real thing comes in
+		retire_image( out );
+		out->U.TEXTURE = SDL_CreateTextureFromSurface( R, L->SURF );
+		out->type = SIMPLE;
+		out->RCT = (SDL_Rect){ 0, 0, L->w, L->h };
+		SDL_DestroySurface( L->SURF );
+		previewed = L->generation;
+		is = 1;
+	}
+	else{
+		SDL_Texture *stand_in = NULL;// a tiled image has nothing to show zoomed out until its mips are made
+		if( previewed == L->generation && out->type == SIMPLE ){
+			stand_in = out->U.TEXTURE;
+			out->type = INVALID;
+		}
+		retire_image( out );// a preview has no path, so it's just destroyed
+		is = image_from_surface( L->path, check_extension( L->path ), L->SURF, out );
+		if( is ){
+			out->path = SDL_strdup( L->path );
+			out->fsize = L->fsize;
+			out->mtime = L->mtime;
+			if( previewed == L->generation ) is = LOAD_REFINED;
+			if( out->type == BIG && out->U.B.tiles && out->U.B.task ){
+				out->U.B.PREVIEW = stand_in;
+				stand_in = NULL;
+			}
+		}
+		if( stand_in ) SDL_DestroyTexture( stand_in );
+	}
+	SDL_free( L );
+	return is;
+}
+
+void cancel_loads(){
+	SDL_AddAtomicInt( &load_generation, 1 );
+}
+
+// only once nothing else can run on the pool
+void drain_loads(){
+	Load_Request *L;
+	cancel_loads();
+	while( ok_queue_pop( &LOADED, &L ) ) finish_load( L, NULL );
+	ok_queue_deinit( &LOADED );
+}
+
+
+/* Batches: a whole lot of files at once, from the command line or dropped in. They're all
+   decoded side by side on the worker pool and come back through BATCHED in whatever order
+   they finish, to be added onto IMAGES as they do. Animations and svgs aren't decoded on
+   the workers, their jobs just hand them back to be loaded on the main thread. */
+typedef struct {
+	char *path;
+	SDL_Surface *SURF;
+	bool direct;// for load_image() to do
+	Uint64 fsize;
+	SDL_Time mtime;
+} Batch_Load;
+
+typedef struct ok_queue_of( Batch_Load* ) batch_queue;
+
+batch_queue BATCHED = OK_QUEUE_INIT;
+Job_Group batch_jobs;
+SDL_AtomicInt batch_cancel;
+int batch_pending = 0;// sent off and not taken back yet, main thread only
+int batch_total = 0;// in the batch under way, for the title
+
+static void batch_job( void *data, int index ){
+	(void) index;
+	Batch_Load *B = data;
+	if( !B->direct && !SDL_GetAtomicInt( &batch_cancel ) ){
+		B->SURF = IMG_Load( B->path );
+		if( B->SURF == NULL ) SDL_Log( "couldn't load %s: %s", B->path, SDL_GetError() );
+	}
+	ok_queue_push( &BATCHED, B );
+	wake_main();
+}
 
-	while(1){
-		bool done = 1;
-		for(int i = len-1; i > 0; i--){
-			if( (rects( ids[i] ).w > rects( ids[i-1] ).w && rects( ids[i] ).w > rects( ids[i-1] ).h) ||
-				(rects( ids[i] ).h > rects( ids[i-1] ).w && rects( ids[i] ).h > rects( ids[i-1] ).h) ){
+void batch_load( const char *path ){
+	if( !check_extension( (char*) path ) ) return;
+	Batch_Load *B = SDL_calloc( 1, sizeof(Batch_Load) );
+	B->path = SDL_strdup( path );
+	B->direct = !prefetchable( B->path );
+	SDL_PathInfo info;
+	if( SDL_GetPathInfo( path, &info ) ){
+		B->fsize = info.size;
+		B->mtime = info.modify_time;
+	}
+	if( batch_pending == 0 ) batch_total = 0;
+	batch_pending += 1;
+	batch_total += 1;
+	pool_submit( POOL, &batch_jobs, batch_job, B, 0 );
+}
 
-				int temp = ids[i-1];
-				ids[i-1] = ids[i];
-				ids[i] = temp;
-				done = 0;
-			}
+// makes out from what came back for B, and frees B. Uploads, so it's main thread only
+int finish_batch_load( Batch_Load *B, Image *out ){
+	int is = 0;
+	batch_pending -= 1;
+	if( B->direct ) is = load_image( B->path, out );
+	else if( B->SURF ){
+		is = image_from_surface( B->path, check_extension( B->path ), B->SURF, out );
+		if( is ){
+			out->path = B->path;
+			out->fsize = B->fsize;
+			out->mtime = B->mtime;
+			B->path = NULL;
 		}
-		if( done ) break;
 	}
+	SDL_free( B->path );
+	SDL_free( B );
+	return is;
+}
 
-	int anchor_size = 2 * len;
-	i2d *anchors = SDL_malloc( anchor_size * sizeof(i2d) );
-
-	int W = rects( ids[0] ).w;
-	int H = rects( ids[0] ).h;
-
-	rects( ids[0] ).x = 0;
-	rects( ids[0] ).y = 0;
-	anchors[0] = (i2d){ W+1, 0 };
-	anchors[1] = (i2d){ 0, H+1 };
-	int anchor_len = 2;
+// whatever's still to come is thrown away
+void drain_batch(){
+	SDL_SetAtomicInt( &batch_cancel, 1 );
+	pool_wait( POOL, &batch_jobs );
+	Batch_Load *B;
+	while( ok_queue_pop( &BATCHED, &B ) ){
+		SDL_DestroySurface( B->SURF );
+		SDL_free( B->path );
+		SDL_free( B );
+	}
+	ok_queue_deinit( &BATCHED );
+	batch_pending = 0;
+}
 
-	for(int i = 1; i < len; i++){
-		
-		int A = -1;
-		float best = 999999;
 
-		for(int a = 0; a < anchor_len; a++){
+/* Grid mode: all of directory_list as a contact sheet. Thumbnails are only made for the rows on
+   screen and a couple either side of them, on the worker pool, and go into cells of a few atlas
+   textures so each atlas is drawn as one Quad_Batch. The least recently drawn cell
+   gets reused when they're all taken. */
+#define GRID_CELL 160// the box a thumbnail fits in, and its cell in the atlas
+#define GRID_GAP 8
+#define GRID_PITCH ( GRID_CELL + GRID_GAP )
+#define GRID_MARGIN_ROWS 2
+#define GRID_ATLAS_SIZE 2048// at most, it's clamped to max_T_size
+#define GRID_ATLASES 4
+#define GRID_CELLS ( GRID_ATLASES * (GRID_ATLAS_SIZE / GRID_CELL) * (GRID_ATLAS_SIZE / GRID_CELL) )// room for the biggest pages
+#define GRID_PENDING -1// besides cells, what an entry can map to
+#define GRID_FAILED -2
 
-			SDL_Rect candidate = (SDL_Rect){ anchors[a].i, anchors[a].j, rects(ids[i]).w, rects(ids[i]).h };
+typedef struct {
+	const char *key;// the entry in it, NULL if it's free
+	int w, h;
+	Uint64 last_drawn;
+} Grid_Cell;
 
-			bool ouch = 0;
-			for(int j = 0; j < i; j++){
-				if( intersecting_or_touching( &candidate, &(imgs[ ids[j] ].RCT) ) ){
-					ouch = 1;
-					break;
-				}
-			}
-			if( ouch ) continue;
-			
-			int right = anchors[a].i + rects(ids[i]).w;
-			int bottom = anchors[a].j + rects(ids[i]).h;
-			int nw = (right > W)? right : W;
-			int nh = (bottom > H)? bottom : H;
-			if( nw == W && nh == H ){
-				A = a;
-				break;
-			}
-			else{
-				float AR = nw / (float) nh;
-				float S = SDL_fabsf( targetAR - AR );
-				if( S < best ){
-					A = a;
-					best = S;
-				}
-			}
+typedef struct {
+	struct thumb_grid_struct *G;
+	const char *key;
+	int index;// in the list, when it was asked for
+	char path [1024];
+	SDL_Surface *SURF;// RGBA32, fits in GRID_CELL. NULL if it couldn't be made
+	bool skipped;// scrolled away before it was its turn
+} Grid_Load;
+
+typedef struct ok_queue_of( Grid_Load* ) grid_queue;
+
+typedef struct thumb_grid_struct{
+	SDL_Texture *atlas [ GRID_ATLASES ];
+	Grid_Cell cells [ GRID_CELLS ];
+	int side, atlas_cells, cells_n;// across a page, in a page and all told, for the size they came out
+	index_map where;// entry -> its cell, or GRID_PENDING / GRID_FAILED. The keys are the grid's own
+	                // copies of the entries, the list can change under it, and go when they're removed
+	Job_Group jobs;
+	grid_queue done;
+	int in_flight;
+	SDL_AtomicInt first, last;// the entries worth making, anything else bails
+	float scroll;
+	Uint64 frame;
+	Quad_Batch batch [ GRID_ATLASES ];
+} Thumb_Grid;
+
+Thumb_Grid *create_thumb_grid(){
+
+	int size = SDL_min( GRID_ATLAS_SIZE, max_T_size );
+	if( size < GRID_CELL ){
+		SDL_Log( "no grid atlas: %d max texture size", max_T_size );
+		return NULL;
+	}
+	Thumb_Grid *G = SDL_calloc( 1, sizeof(Thumb_Grid) );
+	G->side = size / GRID_CELL;
+	G->atlas_cells = G->side * G->side;
+	G->cells_n = GRID_ATLASES * G->atlas_cells;
+	for (int a = 0; a < GRID_ATLASES; ++a ){
+		G->atlas[a] = SDL_CreateTexture( R, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, size, size );
+		if( G->atlas[a] == NULL ){
+			SDL_Log( "no grid atlas: %s", SDL_GetError() );
+			for (int b = 0; b < a; ++b ) SDL_DestroyTexture( G->atlas[b] );
+			SDL_free( G );
+			return NULL;
 		}
-
-		rects( ids[i] ).x = anchors[A].i;
-		rects( ids[i] ).y = anchors[A].j;
-		int right = anchors[A].i + rects(ids[i]).w;
-		int bottom = anchors[A].j + rects(ids[i]).h;
-		anchors[A] = (i2d){ rects( ids[i] ).x, bottom + 1 };
-		anchors[ anchor_len++ ] = (i2d){ right + 1, rects( ids[i] ).y };
-		if(right > W) W = right;
-		if(bottom > H) H = bottom;
+		SDL_SetTextureBlendMode( G->atlas[a], SDL_BLENDMODE_BLEND );
+		G->batch[a] = (Quad_Batch){ .texture = G->atlas[a], .tex_w = size, .tex_h = size };
 	}
+	ok_map_init( &G->where );
+	ok_queue_init( &G->done );
+	SDL_SetAtomicInt( &G->first, 0 );
+	SDL_SetAtomicInt( &G->last, -1 );
+	return G;
+}
 
-	SDL_free( anchors );
-	SDL_free( ids );
-
-
-	return (i2d){ W, H };
-	#undef rects
+void destroy_thumb_grid( Thumb_Grid *G ){
+	SDL_SetAtomicInt( &G->last, -1 );
+	pool_wait( POOL, &G->jobs );
+	Grid_Load *L;
+	while( ok_queue_pop( &G->done, &L ) ){
+		if( L->SURF ) SDL_DestroySurface( L->SURF );
+		SDL_free( L );
+	}
+	ok_queue_deinit( &G->done );
+	ok_map_foreach( &G->where, const char *key, int at ){
+		(void) at;
+		SDL_free( (char*) key );
+	}
+	ok_map_deinit( &G->where );
+	for (int a = 0; a < GRID_ATLASES; ++a ){
+		SDL_DestroyTexture( G->atlas[a] );
+		free_batch( G->batch + a );
+	}
+	SDL_free( G );
 }
 
+// whatever's quickest to get a box-sized version of path from
+static SDL_Surface *grid_thumbnail( char *path, int box ){
 
-bool palette_func(void* closure, const char* name, int length, plutovg_color_t* color){
-    *color = PLUTOVG_MAKE_COLOR(5,5,5,255);
-    return true;
+	SDL_Surface *S = NULL;
+	int full_w, full_h;
+	SDL_PathInfo info;
+	if( SDL_GetPathInfo( path, &info ) ){// one that's been opened before has its window-fit version stored
+		S = load_thumb( path, info.size, info.modify_time, &full_w, &full_h );
+	}
+	#ifdef USE_LIBJPEG
+	int EXT = check_extension( path );
+	if( S == NULL && ( EXT == 2 || EXT == 3 ) ){
+		size_t len;
+		void *bytes = SDL_LoadFile( path, &len );
+		if( bytes ) S = jpeg_preview( bytes, len, box, box, &full_w, &full_h );
+		SDL_free( bytes );
+	}
+	#endif
+	if( S == NULL ) S = IMG_Load( path );
+	if( S && S->format != SDL_PIXELFORMAT_RGBA32 ){
+		SDL_Surface *conv = SDL_ConvertSurface( S, SDL_PIXELFORMAT_RGBA32 );
+		SDL_DestroySurface( S );
+		S = conv;
+	}
+	if( S == NULL ) return NULL;
+
+	// halved most of the way first, so the blur needn't be so wide
+	while( S->w / 2 >= box && S->h / 2 >= box ){
+		SDL_Surface *half = halve_surface( S, NULL );
+		if( half == NULL ) break;
+		SDL_DestroySurface( S );
+		S = half;
+	}
+	if( S->w > box || S->h > box ){
+		SDL_Surface *fit = scale_n_blur( S, box, box, 1.25, NULL );
+		SDL_DestroySurface( S );
+		S = fit;
+	}
+	return S;
 }
 
+static void grid_job( void *data, int index ){
+	(void) index;
+	Grid_Load *L = data;
+	Thumb_Grid *G = L->G;
+	if( L->index < SDL_GetAtomicInt( &G->first ) || L->index > SDL_GetAtomicInt( &G->last ) ){
+		L->skipped = 1;
+	}
+	else L->SURF = grid_thumbnail( L->path, GRID_CELL );
+	ok_queue_push( &G->done, L );
+	wake_main();
+}
 
-Image *IMAGES = NULL;
-int IMAGES_N = 0;
+static int grid_columns(){
+	return SDL_max( 1, ( width - GRID_GAP ) / GRID_PITCH );
+}
 
-int load_image( char *path, Image *out ){
+static SDL_FRect grid_rect( Thumb_Grid *G, int index ){
+	int cols = grid_columns();
+	float x0 = SDL_floorf( 0.5f * ( width - ( cols * GRID_PITCH - GRID_GAP ) ) );
+	return (SDL_FRect){ x0 + ( index % cols ) * GRID_PITCH,
+	                    GRID_GAP + ( index / cols ) * GRID_PITCH - G->scroll, GRID_CELL, GRID_CELL };
+}
 
+static void grid_clamp( Thumb_Grid *G, int count ){
+	int rows = ( count + grid_columns() - 1 ) / grid_columns();
+	float max = SDL_max( 0, rows * GRID_PITCH + GRID_GAP - height );
+	G->scroll = SDL_clamp( G->scroll, 0, max );
+}
 
-	int EXT = check_extension( path );
+void grid_scroll( Thumb_Grid *G, str_vec *list, float dy ){
+	G->scroll = SDL_roundf( G->scroll + dy );
+	grid_clamp( G, ok_vec_count( list ) );
+}
 
-	if( !EXT ) return 0;
+// scrolls just enough for index to be all on screen
+void grid_reveal( Thumb_Grid *G, str_vec *list, int index ){
+	SDL_FRect cell = grid_rect( G, index );
+	if( cell.y < GRID_GAP ) G->scroll += cell.y - GRID_GAP;
+	else if( cell.y + cell.h > height - GRID_GAP ) G->scroll += cell.y + cell.h - ( height - GRID_GAP );
+	grid_clamp( G, ok_vec_count( list ) );
+}
 
-	destroy_Image( out );
+// the entry under x, y, -1 if it's between cells
+int grid_hit( Thumb_Grid *G, str_vec *list, float x, float y ){
+	SDL_FRect first = grid_rect( G, 0 );
+	if( x < first.x || y < first.y ) return -1;
+	int col = ( x - first.x ) / GRID_PITCH;
+	int row = ( y - first.y ) / GRID_PITCH;
+	int index = row * grid_columns() + col;
+	if( col >= grid_columns() || index >= (int) ok_vec_count( list ) ) return -1;
+	SDL_FRect cell = grid_rect( G, index );
+	if( x >= cell.x + cell.w || y >= cell.y + cell.h ) return -1;
+	return index;
+}
 
-	if( EXT == 4 || EXT == 9 ){//.gif or webp
-		IMG_Animation *ANIM = IMG_LoadAnimation( path );
+static void grid_forget( Thumb_Grid *G, const char *key ){
+	ok_map_remove( &G->where, key );
+	SDL_free( (char*) key );
+}
 
-		if( ANIM == NULL ){
-			SDL_Log("bad anim, %s\n", SDL_GetError() );
-			goto loadtexture;
-		}
-		else{
-			if( ANIM->count == 1 ){
-				out->U.TEXTURE = SDL_CreateTextureFromSurface( R,  ANIM->frames[0] );
-				out->type = SIMPLE;
-			}
-			else{
-				SDL_Log( "good anim, %d frames\n", ANIM->count );
-				process_animation( out, ANIM );
-				animating = 1;
-			}
-			IMG_FreeAnimation( ANIM );
+// the free cell, or the one that's gone longest without being drawn. -1 if they're all on screen
+static int grid_take_cell( Thumb_Grid *G ){
+	int best = -1;
+	for (int c = 0; c < G->cells_n; ++c ){
+		if( G->cells[c].key == NULL ) return c;
+		if( G->cells[c].last_drawn < G->frame && ( best < 0 || G->cells[c].last_drawn < G->cells[best].last_drawn ) ){
+			best = c;
 		}
 	}
-	else if( EXT == 10 ){//.svg
-
-		plutosvg_document_t* doc = plutosvg_document_load_from_file( path, 1, 1 );//width, height
-		if (!doc) {
-		    SDL_Log( "Failed to load SVG file: %s\n", path );
-		    return 0;
-		}
-		plutovg_rect_t bounds;
-		plutosvg_document_extents( doc, NULL, &bounds );
-		//SDL_Log( "\n%g,%g,%g,%g", bounds.x, bounds.y, bounds.w, bounds.h );
+	if( best >= 0 ){
+		grid_forget( G, G->cells[best].key );
+		G->cells[best].key = NULL;
+	}
+	return best;
+}
 
+static void grid_request( Thumb_Grid *G, str_vec *list, int index ){
+	const char *entry = ok_vec_get( list, index );
+	if( ok_map_contains( &G->where, entry ) ) return;
 
-		int stride = bounds.w * 4; // Guaranteed 32-bit ARGB (4 bytes per pixel)
-		unsigned char* pixels = SDL_calloc(bounds.h, stride);
+	char *key = SDL_strdup( entry );
+	ok_map_put( &G->where, key, GRID_PENDING );
 
-		plutovg_surface_t* surface = plutovg_surface_create_for_data(pixels, bounds.w, bounds.h, stride);
-		//plutovg_surface_t *surface = plutovg_surface_create(width, height);
-		plutovg_canvas_t *canvas = plutovg_canvas_create( surface );
-		plutovg_canvas_translate( canvas, -bounds.x, -bounds.y );
+	Grid_Load *L = SDL_calloc( 1, sizeof(Grid_Load) );
+	L->G = G;
+	L->key = key;
+	L->index = index;
+	entry_path( L->path, 1024, entry );
+	pool_submit( POOL, &G->jobs, grid_job, L, 0 );
+	G->in_flight++;
+}
 
-		plutovg_color_t currentc = PLUTOVG_MAKE_COLOR(5,5,5,255);
-		bool result = plutosvg_document_render( doc, NULL, canvas, 
-		                                        &currentc, palette_func, NULL);
-		
-		//unsigned char* pixels = plutovg_surface_get_data( surface );
-		//int pitch = SDL_ceil(bounds.w) * 4;
-		//int stride = plutovg_surface_get_stride( surface );
-		//SDL_Log( "pixels: %p, pitch: %d, stride: %d", pixels, pitch, stride );
-
-		SDL_Surface* sdl_surface = SDL_CreateSurfaceFrom( bounds.w, bounds.h, 
-														  SDL_PIXELFORMAT_ARGB8888, 
-														  pixels, stride );
-		//IMG_SavePNG( sdl_surface, "output.png" );
-		if( sdl_surface == NULL ){
-			SDL_Log( "ERROR converting plutosvg surf to SDL: %s", SDL_GetError() );
-		}
+/* Puts finished thumbnails in their cells and, if the grid is up, asks for the ones scrolling
+   into view, the visible ones first. True if there's something new to draw */
+bool grid_update( Thumb_Grid *G, str_vec *list, bool active ){
+
+	bool changed = 0;
+	Grid_Load *L;
+	while( ok_queue_pop( &G->done, &L ) ){
+		G->in_flight--;
+		int c;
+		if( L->skipped ) grid_forget( G, L->key );// asked for again if it comes back into view
+		else if( L->SURF == NULL ) ok_map_put( &G->where, L->key, GRID_FAILED );
+		else if( ( c = grid_take_cell( G ) ) < 0 ) grid_forget( G, L->key );
 		else{
-		    out->U.TEXTURE = SDL_CreateTextureFromSurface( R, sdl_surface );
-		    out->type = SIMPLE;
+			int k = c % G->atlas_cells;
+			SDL_Rect at = (SDL_Rect){ ( k % G->side ) * GRID_CELL, ( k / G->side ) * GRID_CELL, L->SURF->w, L->SURF->h };
+			SDL_UpdateTexture( G->atlas[ c / G->atlas_cells ], &at, L->SURF->pixels, L->SURF->pitch );
+			G->cells[c] = (Grid_Cell){ L->key, L->SURF->w, L->SURF->h, G->frame };
+			ok_map_put( &G->where, L->key, c );
+			changed = 1;
 		}
-
-	    SDL_DestroySurface(sdl_surface); 
-	    plutovg_canvas_destroy(canvas);  
-	    plutovg_surface_destroy(surface);
-    	plutosvg_document_destroy(doc);  
+		if( L->SURF ) SDL_DestroySurface( L->SURF );
+		SDL_free( L );
 	}
-	else{
-		loadtexture:
-		out->U.TEXTURE = IMG_LoadTexture( R, path );
-		out->type = SIMPLE;
+
+	if( !active ){
+		SDL_SetAtomicInt( &G->last, -1 );
+		return changed;
 	}
 
-	if( out->type == INVALID || (out->type == SIMPLE && out->U.TEXTURE == NULL) ){
-		SDL_Log("bad texture: %s\n", SDL_GetError());
-		
-		SDL_Surface *SURF = IMG_Load( path );
+	int count = ok_vec_count( list );
+	int cols = grid_columns();
+	grid_clamp( G, count );
+	int top = G->scroll / GRID_PITCH;
+	int bottom = ( G->scroll + height ) / GRID_PITCH;
+	int visible_first = top * cols;
+	int visible_last = SDL_min( count-1, ( bottom + 1 ) * cols - 1 );
+	int first = SDL_max( 0, top - GRID_MARGIN_ROWS ) * cols;
+	int last = SDL_min( count-1, ( bottom + 1 + GRID_MARGIN_ROWS ) * cols - 1 );
+	SDL_SetAtomicInt( &G->first, first );
+	SDL_SetAtomicInt( &G->last, last );
+
+	int cap = 2 * POOL->N;
+	for (int i = visible_first; i <= visible_last && G->in_flight < cap; ++i ) grid_request( G, list, i );
+	for (int i = visible_last+1; i <= last && G->in_flight < cap; ++i ) grid_request( G, list, i );
+	for (int i = visible_first-1; i >= first && G->in_flight < cap; --i ) grid_request( G, list, i );
+	return changed;
+}
 
-		if( SURF == NULL ){
-			SDL_Log( "bad surface" );
-			SDL_snprintf( buffer, bufflen, "ERROR: %s", SDL_GetError() );
-			SDL_SetWindowTitle( window, buffer );
-			return 0;
+/* Thumbnails batched by atlas, outlines where they're still to come and a frame around current.
+   Lines are in the current draw color */
+void render_grid( Thumb_Grid *G, str_vec *list, int current ){
+
+	G->frame++;
+	SDL_FRect waiting [ 256 ];
+	int waiting_n = 0;
+
+	int count = ok_vec_count( list );
+	int cols = grid_columns();
+	int first = ( G->scroll / GRID_PITCH ) * cols;
+	int last = SDL_min( count-1, ( ( G->scroll + height ) / GRID_PITCH + 1 ) * cols - 1 );
+
+	for (int i = first; i <= last; ++i ){
+		SDL_FRect cell = grid_rect( G, i );
+		int *c = ok_map_get_ptr( &G->where, ok_vec_get( list, i ) );
+		if( c && *c >= 0 ){
+			Grid_Cell *C = G->cells + *c;
+			C->last_drawn = G->frame;
+			int a = *c / G->atlas_cells;
+			int k = *c % G->atlas_cells;
+			SDL_FRect src = (SDL_FRect){ ( k % G->side ) * GRID_CELL, ( k / G->side ) * GRID_CELL, C->w, C->h };
+			SDL_FRect dst = (SDL_FRect){ cell.x + ( GRID_CELL - C->w ) / 2, cell.y + ( GRID_CELL - C->h ) / 2, C->w, C->h };
+			batch_quad( G->batch + a, &dst, &src, 0, SDL_FLIP_NONE, (SDL_FColor){ 1, 1, 1, 1 } );
 		}
-		else{
-			/* This feature is cool.... but SDL can't actually process big images at all!
-			if( SURF->w > max_T_size || SURF->h > max_T_size ){ // Too big.... break it up into a grid
-				int gnx = SDL_ceilf( SURF->w / (float)max_T_size );
-				int gny = SDL_ceilf( SURF->h / (float)max_T_size );
-				int gw = SDL_ceilf( SURF->w / (float)gnx );
-				int gh = SDL_ceilf( SURF->h / (float)gny );
-				//SDL_Log( "breaking in up into a %dx%d of %dx%d px each.\n", gnx, gny, gw, gh );
-
-				if( out != IMAGES ){
-					SDL_snprintf( buffer, bufflen, "\"%s\" is too large to be opened in a group. Open it by itself.", path );
-				  	SDL_SetWindowTitle( window, buffer );
-				  	return 0;
-				}
-
-				IMAGES_N = gnx * gny;
-				IMAGES = SDL_realloc( IMAGES, IMAGES_N * sizeof(Image) );
-				SDL_memset( IMAGES, 0, IMAGES_N * sizeof(Image) );
-				int I = 0;
-
-				SDL_Surface *bufsurf = SDL_CreateSurface( gw, gh, SURF->format );
-				SDL_Rect src = (SDL_Rect){ 0, 0, gw, gh };
-
-				for (int j = 0; j < gny; ++j ){
-					for (int i = 0; i < gnx; ++i ){
-						SDL_BlitSurface( SURF, &src, bufsurf, NULL );
-						IMAGES[I].type = SIMPLE;
-						IMAGES[I].U.TEXTURE = SDL_CreateTextureFromSurface( R, bufsurf );
-						IMAGES[I].RCT.x = src.x;
-						IMAGES[I].RCT.y = src.y;
-						I++;
-						src.x += gw;
-					}
-					src.y += gh;
-				}
-
-				return 2;
-			}
-			else{*/
-
-			out->U.TEXTURE = SDL_CreateTextureFromSurface( R, SURF );
-			out->type = SIMPLE;
-			SDL_DestroySurface( SURF );
+		else if( waiting_n < 256 ){
+			waiting[ waiting_n++ ] = cell;
 		}
 	}
-	
-	if( out->type == SIMPLE ){
-		float fw, fh;
-		SDL_GetTextureSize( out->U.TEXTURE, &fw, &fh );
-		out->RCT = (SDL_Rect){ 0, 0, fw, fh };
-
-		if( antialiasing > 0 && (out->RCT.w <= 256 || out->RCT.h <= 256) ){
-			antialiasing = SDL_SCALEMODE_NEAREST;//SDL_SCALEMODE_PIXELART;
-			SDL_SetTextureScaleMode( out->U.TEXTURE, antialiasing );
-		}
+	for (int a = 0; a < GRID_ATLASES; ++a ) flush_batch( G->batch + a );
+	SDL_RenderRects( R, waiting, waiting_n );
 
-		if( (fw > width || fh > height) && EXT != 10 ){
-			out->type = BIG;
-			out->U.B.SCALEDnBLURRED = NULL;
-			//float xs = width / fw;
-			//float ys = height / fh;
-			//out->U.B.zoom_threshhold =  //SDL_min( xs, ys );
-			out->U.B.task = launch_LSnB_thread( path, width, height, 1.25 );
-			tasking += 1;
-		}
+	if( current >= first && current <= last ){
+		SDL_FRect cell = grid_rect( G, current );
+		SDL_RenderRect( R, &(SDL_FRect){ cell.x - 3, cell.y - 3, cell.w + 6, cell.h + 6 } );
 	}
-
-	return 1;
 }
 
 
@@ -878,6 +4266,11 @@ int load_image( char *path, Image *out ){
 					            INDEX, ok_vec_count( &directory_list ) );           \
 				  SDL_SetWindowTitle( window, buffer );
 
+#define SWT_grid() SDL_snprintf( buffer, bufflen, "%s  •  [%d / %d]",              \
+					             ok_vec_get(&directory_list, INDEX),              \
+					             INDEX, ok_vec_count( &directory_list ) );        \
+				   SDL_SetWindowTitle( window, buffer );
+
 #define SWT_imgs() SDL_snprintf( buffer, bufflen, "Introscopia's ImageViewer. %d images", IMAGES_N ); \
 				   SDL_SetWindowTitle( window, buffer );
 
@@ -905,9 +4298,21 @@ int main(int argc, char *argv[]){
 	//SDL_MaximizeWindow( window );
 	SDL_GetWindowSize( window, &width, &height );
 
+	// presents wait on the display, so drawing every frame while something moves costs nothing extra
+	bool vsync = SDL_SetRenderVSync( R, 1 );
+	if( !vsync ) SDL_Log( "no vsync: %s", SDL_GetError() );
+	WAKE_EVENT = SDL_RegisterEvents( 1 );
+
 	SDL_PropertiesID RPID = SDL_GetRendererProperties( R );
 	max_T_size = SDL_GetNumberProperty( RPID, SDL_PROP_RENDERER_MAX_TEXTURE_SIZE_NUMBER, 0);
 
+	select_blur_kernels( BLUR_AVX2 );
+	POOL = create_worker_pool( SDL_GetNumLogicalCPUCores() );
+	init_prefetcher( 512 * 1024 * 1024 );
+	init_recent_images( 256 * 1024 * 1024 );
+	init_thumb_store();
+	pool_submit( POOL, NULL, prune_thumb_store, NULL, 0 );
+
 
 	SDL_srand(0);
 
@@ -959,8 +4364,30 @@ int main(int argc, char *argv[]){
 	
 
 	str_vec directory_list;
+	ok_vec_init( &directory_list );
+	String_Arena directory_strings = {0};
+	index_map directory_index;// entry -> where it is in directory_list
+	ok_map_init( &directory_index );
 
 	bool KONTINUOUS = false;
+	bool tiles_pending = 0;// some visible tiles are still to be uploaded
+	Uint64 next_frame = 0;// SDL_GetTicksNS() when the soonest on-screen animation frame is due, 0 for none
+	int shown = 0;// how many images the last frame drew,
+	int *visible = NULL;// and which, NULL for the first `shown`
+	Sint32 wait = 0;// how long the loop may sleep for events, -1 for as long as it takes
+	int nav_dir = 0, nav_tries = 0;// while looking for the next entry that loads
+	bool nav_step = 0, nav_loaded = 0;
+	Folder_Scan *SCAN = NULL;// F6's, while it's running
+	Folder_Watcher *WATCH = NULL;
+	Uint64 scan_title_time = 0;
+	Layout_Index layout = {0};// over the packed IMAGES, when there's more than one
+	Quad_Batch corner_batch = {0};// flat, for when there's no atlas to put the corner marks in with
+	Loose_Draw *loose = NULL;// what didn't go in a batch, this frame
+	int loose_cap = 0;
+	Thumb_Grid *GRID = NULL;// made the first time it's asked for, then kept
+	bool grid_mode = 0, grid_open = 0;
+	int grid_from = 0;// INDEX when the grid came up
+	char grid_key [1024] = "";// and its entry, the watcher can move it meanwhile
 
 
 	if( argc >= 2 ){
@@ -991,17 +4418,24 @@ int main(int argc, char *argv[]){
 			remote_operation = true;
 		}
 
-		load_folderlist( &directory_list, pfname, 1 );
+		load_folderlist( &directory_list, &directory_strings, &directory_index, pfname + folderpath_len, 1 );
+		WATCH = start_folder_watcher();
 
-		IMAGES_N = argc-1;
-		IMAGES = SDL_calloc( IMAGES_N, sizeof(Image) );
-		
 		int is = 0;
-		for (int i = 1; i < argc; ++i ){
+		if( argc == 2 ){// comes in like a navigation would, so a stored thumbnail can go up first
+			IMAGES_N = 1;
+			IMAGES = SDL_calloc( IMAGES_N, sizeof(Image) );
 			SWT_Loading();
-			is = load_image( pfname, IMAGES + i-1 );
-
-			if( i < argc-1 ) CP_ACP_to_UTF8( pfname, argv[i+1] );
+			nav_dir = 1;
+			is = request_image( pfname, IMAGES + 0 );
+		}
+		else{// the loop packs them in as they come
+			for (int i = 1; i < argc; ++i ){
+				batch_load( pfname );
+				if( i < argc-1 ) CP_ACP_to_UTF8( pfname, argv[i+1] );
+			}
+			SDL_snprintf( buffer, bufflen, "Loading %d images...", batch_total );
+			SDL_SetWindowTitle( window, buffer );
 		}
 		/*
 			if( is == 2 ){// img which got split into a grid
@@ -1014,16 +4448,11 @@ int main(int argc, char *argv[]){
 			} else if( is == 1 ){
 			*/
 		
-		if( argc > 2 ){
-			i2d total = pack_imgs( IMAGES, IMAGES_N );
-			W = total.i; H = total.j;
-			SDL_Rect box = (SDL_Rect){0,0,W,H};
-			calc_transform( &T, &box, 0 );
-			SWT_imgs();
-		} else if( is ) {
+		if( is == 1 ) {
 			W = IMAGES[0].RCT.w; H = IMAGES[0].RCT.h;
 			calc_transform( &T, &(IMAGES[0].RCT), 0 );
 			SWT_img();
+			prefetch_around( &directory_list, INDEX );
 		}
 	}
 
@@ -1039,8 +4468,10 @@ int main(int argc, char *argv[]){
 
 		int update = first;
 		if( first > 0 ) first--;
+		bool woken = 0;// a worker's handed something back
 
 		SDL_Event event;
+		SDL_WaitEventTimeout( NULL, wait );
 		while( SDL_PollEvent(&event) ){
 
 			int psel = INDEX;
@@ -1204,8 +4635,31 @@ int main(int argc, char *argv[]){
 						    /**SDL_SCALEMODE_PIXELART  < nearest pixel sampling with improved scaling for pixel art */
 							break;
 
-						case 'b':// BLUR
-							enable_blur = !enable_blur;
+						case 'b':// MIPMAPS (blurred when zoomed out)
+							enable_mips = !enable_mips;
+							break;
+
+						case 'g':// GRID of the whole folder
+							if( grid_mode ){// back to what was up
+								grid_mode = 0;
+								int was = find_in_folderlist( &directory_index, grid_key );
+								INDEX = was >= 0 ? was : SDL_min( grid_from, (int) ok_vec_count( &directory_list ) - 1 );
+								SWT_img();
+							}
+							else if( IMAGES_N == 1 && batch_pending == 0 && ok_vec_count( &directory_list ) > 0 ){
+								if( GRID == NULL ) GRID = create_thumb_grid();
+								if( GRID ){
+									grid_mode = 1;
+									grid_from = INDEX;
+									SDL_strlcpy( grid_key, ok_vec_get( &directory_list, INDEX ), 1024 );
+									grid_reveal( GRID, &directory_list, INDEX );
+									SWT_grid();
+								}
+							}
+							break;
+
+						case SDLK_RETURN:
+							if( grid_mode ) grid_open = 1;
 							break;
 
 						case 's':{// SHUFFLE LIST
@@ -1213,14 +4667,12 @@ int main(int argc, char *argv[]){
 							SDL_strlcpy( pfname, ok_vec_get( &directory_list, INDEX ), 512 );
 
 							shuffle_str_list( ok_vec_begin(&directory_list), ok_vec_count(&directory_list) );
+							index_folderlist( &directory_index, &directory_list, 0 );
 
 							// find where we are in the list
-							for (int i = 0; i < ok_vec_count( &directory_list ); ++i){	
-								if( strrcmp( pfname, ok_vec_get( &directory_list, i ) ) == 0 ){
-									INDEX = i;
-									break;
-								}
-							}
+							int i = find_in_folderlist( &directory_index, pfname );
+							if( i >= 0 ) INDEX = i;
+							prefetch_around( &directory_list, INDEX );
 							} break;
 
 						case SDLK_F5:{
@@ -1229,21 +4681,15 @@ int main(int argc, char *argv[]){
 							char pfname [512];
 							SDL_strlcpy( pfname, ok_vec_get( &directory_list, INDEX ), 512 );
 
-							destroy_str_vec( &directory_list );
-							load_folderlist( &directory_list, pfname, 1 );
+							free_folderlist( &directory_list, &directory_strings, &directory_index );
+							load_folderlist( &directory_list, &directory_strings, &directory_index, pfname, 1 );
+							listing_depth = 1;
 							} break;
 
-						case SDLK_F6:{
-
-							//psel = -1;
-							char pfname [512];
-							SDL_strlcpy( pfname, ok_vec_get( &directory_list, INDEX ), 512 );
-
-							destroy_str_vec( &directory_list );
-							load_folderlist( &directory_list, pfname, 9999 );
-
-							SWT_img();
-							} break;
+						case SDLK_F6:
+							// the list gets swapped in once it's done, see below
+							if( SCAN == NULL ) SCAN = start_folder_scan( 9999 );
+							break;
 
 						case SDLK_F11:
 							if( fullscreen ){
@@ -1271,7 +4717,9 @@ int main(int argc, char *argv[]){
 								char path [256];
 								SDL_RemovePath( ok_vec_get( &directory_list, INDEX ) );
 								//remove_item_from_string_list( &directory_list, INDEX, &list_len );
+								ok_map_remove( &directory_index, ok_vec_get( &directory_list, INDEX ) );
 								ok_vec_remove_at( &directory_list, INDEX );
+								index_folderlist( &directory_index, &directory_list, INDEX );// they all moved down one
 								//destroy_Image( IMAGES+0 );
 								//INDEX++;
 								psel--;
@@ -1297,6 +4745,9 @@ int main(int argc, char *argv[]){
 							sel_rect.w = SDL_abs( mouseX - clickX );
 							sel_rect.h = SDL_abs( mouseY - clickY );
 						}
+						else if( grid_mode ){
+							grid_scroll( GRID, &directory_list, -event.motion.yrel );
+						}
 						else{
 							T.tx += event.motion.xrel;
 							T.ty += event.motion.yrel;
@@ -1329,6 +4780,16 @@ int main(int argc, char *argv[]){
 						dir = 1; psel -= 1;
 					}
 					else mousePressed = 1;
+
+					if( grid_mode && event.button.button == SDL_BUTTON_LEFT ){// pick, and open on a double click
+						int hit = grid_hit( GRID, &directory_list, event.button.x, event.button.y );
+						if( hit >= 0 ){
+							INDEX = hit;
+							psel = INDEX;
+							SWT_grid();
+							if( event.button.clicks == 2 ) grid_open = 1;
+						}
+					}
 					update = 1;
 
 
@@ -1358,6 +4819,11 @@ int main(int argc, char *argv[]){
 					break;
 				case SDL_EVENT_MOUSE_WHEEL:;
 
+					if( grid_mode ){
+						grid_scroll( GRID, &directory_list, -event.wheel.y * GRID_PITCH / 2 );
+						update = 1;
+						break;
+					}
 					float xrd = (mouseX - T.tx) / T.scale;
 					float yrd = (mouseY - T.ty) / T.scale;
 					T.scale_i -= event.wheel.y;
@@ -1378,25 +4844,11 @@ int main(int argc, char *argv[]){
 					SDL_snprintf( buffer, bufflen, "Adding \"%s\" via drop...", event.drop.data );
 					SDL_SetWindowTitle( window, buffer );
 
-					int I = IMAGES_N;
-					IMAGES_N += 1;
-					IMAGES = SDL_realloc( IMAGES, IMAGES_N * sizeof(Image) );
-					SDL_memset( IMAGES+I, 0, sizeof(Image) );
+					cancel_loads();// they'd land on IMAGES[0]
+					nav_step = 0;
+					grid_mode = 0;
 					//SDL_Log("loading %s",  event.drop.data );
-					if( !load_image( event.drop.data, IMAGES + I ) ){
-						IMAGES_N -= 1;
-						IMAGES = SDL_realloc( IMAGES, IMAGES_N * sizeof(Image) );
-					}
-					else{
-						//SDL_Log("success! now pack it.." );
-						i2d total = pack_imgs( IMAGES, IMAGES_N );
-						W = total.i; H = total.j;
-						//SDL_Log("packed. W: %d, H: %d", W, H );
-						SDL_Rect box = (SDL_Rect){0,0,W,H};
-						calc_transform( &T, &box, 0 );
-						SWT_imgs();
-						update = 1;
-					}
+					batch_load( event.drop.data );// packed in once it's decoded
 
 					} break;
 
@@ -1421,50 +4873,171 @@ int main(int argc, char *argv[]){
 					update = 1;
 				break;
 
+				case SDL_EVENT_WINDOW_EXPOSED:
+					update = 1;
+					break;
+
+				case SDL_EVENT_RENDER_TARGETS_RESET:// the atlases are render targets, their contents are gone
+					reload_atlases( IMAGES, IMAGES_N );
+					update = 1;
+					break;
+
+				case SDL_EVENT_RENDER_DEVICE_RESET:// and here the textures themselves, the atlases are made from those
+					reload_images( IMAGES, IMAGES_N );
+					update = 1;
+					break;
+
+				default:
+					// the workers have handed something back, it's picked up below
+					if( event.type == WAKE_EVENT ){
+						SDL_SetAtomicInt( &wake_pending, 0 );
+						woken = 1;
+					}
+					break;
 			}
 
-			if( psel != INDEX && !KONTINUOUS && IMAGES_N == 1 ){
-				int count = 0;
+			if( grid_mode ){// the arrows just move the pick
+				if( dir ){
+					INDEX = cycle( INDEX + dir, 0, ok_vec_count( &directory_list ) );
+					grid_reveal( GRID, &directory_list, INDEX );
+					SWT_grid();
+				}
+			}
+			else if( psel != INDEX && !KONTINUOUS && IMAGES_N == 1 && batch_pending == 0 ){
 				animating = 0;
-				char path [1024];
-				int is = 0;
+				nav_dir = dir;
+				nav_tries = 0;
+				nav_step = 1;
+			}
+		}
 
-				while( count < ok_vec_count( &directory_list ) ){
+		if( SCAN ){
+			if( folder_scan_done( SCAN ) ){
+				char pfname [512];
+				SDL_strlcpy( pfname, ok_vec_get( &directory_list, INDEX ), 512 );
 
-					INDEX = cycle( INDEX+dir, 0, ok_vec_count( &directory_list ) );
-					//SDL_Log("INDEX[%d]: %s\n", INDEX, ok_vec_get( &directory_list, INDEX ) );
+				free_folderlist( &directory_list, &directory_strings, &directory_index );
+				listing_depth = SCAN->max_depth;
+				finish_folder_scan( SCAN, &directory_list, &directory_strings, &directory_index, pfname );
+				SCAN = NULL;
 
-					if( remote_operation ){
-						SDL_snprintf( path, 1024, "%s%s", folderpath, ok_vec_get( &directory_list, INDEX ) );
-					} else {
-						SDL_strlcpy( path, ok_vec_get( &directory_list, INDEX ), 1024 );
-					}
-					//SDL_Log("path: %s\n", path );
+				SWT_img();
+				prefetch_around( &directory_list, INDEX );
+			}
+			else if( SDL_GetTicks() - scan_title_time > 250 ){
+				SDL_snprintf( buffer, bufflen, "Scanning subfolders... %d images in %d folders",
+				              SDL_GetAtomicInt( &(SCAN->files) ), SDL_GetAtomicInt( &(SCAN->dirs) ) );
+				SDL_SetWindowTitle( window, buffer );
+				scan_title_time = SDL_GetTicks();
+			}
+		}
+
+		if( WATCH ){
+			int delta = apply_folder_changes( WATCH, &directory_list, &directory_strings, &directory_index );
+			if( delta == FOLDER_LOST_CURRENT && IMAGES_N == 1 && batch_pending == 0 && ok_vec_count( &directory_list ) > 0 ){
+				// on to whatever took its place
+				INDEX -= 1;
+				nav_dir = 1;
+				nav_tries = 0;
+				nav_step = 1;
+			}
+			else if( delta ){
+				if( IMAGES_N == 1 ){ SWT_img(); }
+				prefetch_around( &directory_list, INDEX );
+			}
+		}
+
+		// steps through the entries until one loads, decodes come back over the next frames
+		Load_Request *LR;
+		while( ok_queue_pop( &LOADED, &LR ) ){
+			int is = finish_load( LR, IMAGES + 0 );
+			if( is == 1 ) nav_loaded = 1;
+			else if( is == LOAD_REFINED ) update = 1;
+			else if( is == 0 ) nav_step = 1;// skip it, like the synchronous loads do
+		}
+		// batch loads go in as they're done, packed in next to the rest
+		Batch_Load *BL;
+		int taken = 0, batched = 0;
+		while( ok_queue_pop( &BATCHED, &BL ) ){
+			taken += 1;
+			if( IMAGES_N == 1 && ( IMAGES[0].type == INVALID || IMAGES[0].path == NULL ) ){
+				// the load that was going when they were dropped got cancelled (or failed), leaving
+				// nothing or a preview, so they take its place rather than packing in around it
+				destroy_Image( IMAGES );
+				IMAGES_N = 0;
+				free_packing();
+			}
+			IMAGES = SDL_realloc( IMAGES, ( IMAGES_N + 1 ) * sizeof(Image) );
+			SDL_memset( IMAGES + IMAGES_N, 0, sizeof(Image) );
+			if( finish_batch_load( BL, IMAGES + IMAGES_N ) ){
+				IMAGES_N += 1;
+				i2d total = pack_one_more( IMAGES, IMAGES_N );
+				W = total.i; H = total.j;
+				batched += 1;
+			}
+		}
+		if( batched ){
+			index_layout( &layout, IMAGES, IMAGES_N, W, H );
+			atlas_images( IMAGES, IMAGES_N );
+			SDL_Rect box = (SDL_Rect){0,0,W,H};
+			calc_transform( &T, &box, 0 );
+			update = 1;
+		}
+		if( taken ){
+			if( batch_pending > 0 ){
+				SDL_snprintf( buffer, bufflen, "Loading... %d / %d", batch_total - batch_pending, batch_total );
+				SDL_SetWindowTitle( window, buffer );
+			}
+			else{ SWT_imgs(); }
+		}
+		if( grid_open ){
+			grid_open = 0;
+			grid_mode = 0;
+			if( SDL_strcmp( ok_vec_get( &directory_list, INDEX ), grid_key ) != 0 ){
+				INDEX -= 1;
+				nav_dir = 1;
+				nav_tries = 0;
+				nav_step = 1;
+			}
+			else{ SWT_img(); }
+			update = 1;
+		}
+		if( GRID && grid_update( GRID, &directory_list, grid_mode ) ) update = 1;
 
-					//CP_ACP_to_UTF8( path, buffer ); // CP_ACP_to_UTF8( path );
-					//SDL_Log("loading path: %s\n", path );
+		if( nav_step ){
+			nav_step = 0;
+			char path [1024];
+			int is = 0;
 
-					SWT_Loading();
-					is = load_image( path, IMAGES + 0 );
-					if( is ) break;
+			while( nav_tries < ok_vec_count( &directory_list ) ){
 
-					count++;
-				}
-				
-				if( is == 2 ){
-					W = IMAGES[ IMAGES_N-1 ].RCT.x + IMAGES[ IMAGES_N-1 ].RCT.w;
-					H = IMAGES[ IMAGES_N-1 ].RCT.y + IMAGES[ IMAGES_N-1 ].RCT.h;
-					SDL_Rect box = (SDL_Rect){0,0,W,H};
-					calc_transform( &T, &box, 0 );
-				} else if( is == 1 ) {
-					W = IMAGES[0].RCT.w; H = IMAGES[0].RCT.h;
-					calc_transform( &T, &(IMAGES[0].RCT), 0 );
-				}
-				SWT_img();
+				INDEX = cycle( INDEX+nav_dir, 0, ok_vec_count( &directory_list ) );
+				//SDL_Log("INDEX[%d]: %s\n", INDEX, ok_vec_get( &directory_list, INDEX ) );
+
+				entry_path( path, 1024, ok_vec_get( &directory_list, INDEX ) );
+				//SDL_Log("path: %s\n", path );
+
+				SWT_Loading();
+				nav_tries++;
+				is = request_image( path, IMAGES + 0 );
+				if( is ) break;
 			}
+			if( is == 1 ) nav_loaded = 1;
+		}
+		if( nav_loaded ){
+			nav_loaded = 0;
+			W = IMAGES[0].RCT.w; H = IMAGES[0].RCT.h;
+			calc_transform( &T, &(IMAGES[0].RCT), 0 );
+			SWT_img();
+			prefetch_around( &directory_list, INDEX );
+			update = 1;
 		}
 
-		if( pan_up || pan_down || pan_left || pan_right ){
+		if( grid_mode && ( pan_up || pan_down ) ){
+			grid_scroll( GRID, &directory_list, 3 * panV * ( pan_down - pan_up ) );
+			update = 1;
+		}
+		else if( pan_up || pan_down || pan_left || pan_right ){
 
 			if( pan_up    ) T.ty += panV;
 			if( pan_down  ) T.ty -= panV;
@@ -1501,61 +5074,139 @@ int main(int argc, char *argv[]){
 			}
 		}
 
-		if( update || animating || tasking ){
+		if( tasking ){// mips get uploaded as they're made, on screen or not
+			for (int i = 0; i < IMAGES_N; ++i ){
+				if( IMAGES[i].type != BIG || IMAGES[i].U.B.task == NULL ) continue;
+				int had = IMAGES[i].U.B.mip_count;
+				if( check_mip_task( R, IMAGES[i].U.B.task, IMAGES[i].U.B.MIPS, &(IMAGES[i].U.B.mip_count) ) ){
+					cancel_and_destroy_task( IMAGES[i].U.B.task, NULL );
+					IMAGES[i].U.B.task = NULL;
+					tasking -= 1;
+					SDL_DestroyTexture( IMAGES[i].U.B.PREVIEW );
+					IMAGES[i].U.B.PREVIEW = NULL;
+					update = 1;
+				}
+				if( IMAGES[i].U.B.mip_count != had ) update = 1;
+			}
+		}
+		if( woken ){// svg renders get uploaded as they come in, and drawn if they're still on screen
+			for (int i = 0; i < IMAGES_N; ++i ){
+				if( IMAGES[i].SVG && collect_svg_render( IMAGES[i].SVG ) ) update = 1;
+			}
+		}
+		// on-screen animations only get a redraw when one of them actually has a new frame up
+		// (or a decoder that was behind has caught up)
+		if( animating && !update && ( woken || ( next_frame > 0 && SDL_GetTicksNS() + ANIM_SLACK >= next_frame ) ) ){
+			bool dirty = false;
+			next_frame = tick_animations( IMAGES, visible, shown, &dirty );
+			if( dirty ) update = 1;
+		}
+
+		if( update || tiles_pending ){
 
+			tiles_pending = 0;
 			SDL_SetRenderDrawColor( R, bg[sel_bg].r, bg[sel_bg].g, bg[sel_bg].b, bg[sel_bg].a );
 			SDL_RenderClear( R );
 
-			for (int i = 0; i < IMAGES_N; ++i ){
+			if( grid_mode ){
+				if( sel_bg > 2 ) SDL_SetRenderDrawColor( R, bg[0].r, bg[0].g, bg[0].b, bg[0].a );
+				else SDL_SetRenderDrawColor( R, bg[4].r, bg[4].g, bg[4].b, bg[4].a );
+				render_grid( GRID, &directory_list, INDEX );
+				shown = 0;
+				next_frame = 0;
+			}
+			else{
+				// corner marks and atlased images go out in batches. An atlased image's marks go in
+				// its atlas's batch just ahead of it, whatever's drawn on its own waits for all of them,
+				// so each still ends up over its marks
+				SDL_Color cc = sel_bg > 2 ? bg[0] : bg[4];// a contrasting color
+				SDL_FColor corner_color = { cc.r / 255.0f, cc.g / 255.0f, cc.b / 255.0f, 1 };
+				Quad_Batch *loose_marks = ATLASES_N > 0 ? &(ATLASES[0].batch) : &corner_batch;
+				if( loose_cap < IMAGES_N ){
+					loose_cap = IMAGES_N;
+					loose = SDL_realloc( loose, loose_cap * sizeof(Loose_Draw) );
+				}
+				int loose_n = 0;
+
+				// only what's in the window
+				shown = IMAGES_N;
+				visible = NULL;
+				if( IMAGES_N > 1 && layout.n == IMAGES_N ){
+					SDL_FRect area = (SDL_FRect){ -T.tx / T.scale, -T.ty / T.scale, width / T.scale, height / T.scale };
+					shown = query_layout( &layout, IMAGES, &area, angle_i % 2 != 0 );
+					visible = layout.visible;
+				}
+				bool dirty = false;
+				next_frame = animating? tick_animations( IMAGES, visible, shown, &dirty ) : 0;
 
-				SDL_Texture *TEX = NULL;
-				SDL_FRect DST = apply_transform_rect( &(IMAGES[i].RCT), &T );
+				for (int v = 0; v < shown; ++v ){
 
-				switch( IMAGES[i].type ){
+					int i = visible? visible[v] : v;
+					SDL_Texture *TEX = NULL;
+					Tile_Cache *TILES = NULL;
+					Svg_Render *SVG = NULL;
+					SDL_FRect DST = apply_transform_rect( &(IMAGES[i].RCT), &T );
 
-					case SIMPLE:
-						TEX = IMAGES[i].U.TEXTURE;
-						break;
+					Quad_Batch *marks = IMAGES[i].ATLAS ? &(IMAGES[i].ATLAS->batch) : loose_marks;
+					batch_corners( marks, &DST, 5, corner_color, &atlas_white );
 
-					case BIG:
-						if( IMAGES[i].U.B.task ){
-							SDL_Texture *t = check_LSnB_Task( R, IMAGES[i].U.B.task );
-							if( t != NULL ){
-								IMAGES[i].U.B.SCALEDnBLURRED = t;
-								cancel_and_destroy_task( IMAGES[i].U.B.task );
-								IMAGES[i].U.B.task = NULL;
-								tasking -= 1;
-								if( enable_blur ){
-									TEX = IMAGES[i].U.B.SCALEDnBLURRED;
-								}
-								else TEX =  IMAGES[i].U.B.ORIGINAL;
+					switch( IMAGES[i].type ){
+
+						case SIMPLE:
+							if( IMAGES[i].SVG ){// zoomed in there's a sharper one for what's in the window
+								float iw = IMAGES[i].RCT.w;
+								SDL_FRect need = image_area_in_window( &DST, iw, IMAGES[i].RCT.h, ANGLE, FLIP );
+								bool covers = false;
+								SVG = svg_render_for( IMAGES[i].SVG, &need, DST.w / iw, iw, IMAGES[i].RCT.h, &covers );
+								if( covers ) break;// nothing of the base would show
 							}
-							else TEX =  IMAGES[i].U.B.ORIGINAL;
-						}
-						else{
-							if( enable_blur && T.scale < blur_zoom_threshhold ){
-								TEX = IMAGES[i].U.B.SCALEDnBLURRED;
-							} else {
-								TEX = IMAGES[i].U.B.ORIGINAL;
+							if( IMAGES[i].ATLAS ){
+								batch_quad( &(IMAGES[i].ATLAS->batch), &DST, &(IMAGES[i].ATLAS_SRC), ANGLE, FLIP, (SDL_FColor){ 1, 1, 1, 1 } );
 							}
-						}
-						break;
+							else TEX = IMAGES[i].U.TEXTURE;
+							break;
 
-					case ANIMATION:
-						animation_tick( IMAGES + i );
-						TEX = IMAGES[i].U.A.TEXTURES[ IMAGES[i].U.A.FRAME ];
-						break;
+						case BIG:
+							TEX = pick_mip( IMAGES + i, T.scale );
+							if( TEX == NULL ){
+								TILES = IMAGES[i].U.B.tiles;
+								// whatever mip there is goes underneath while the tiles come in
+								if( IMAGES[i].U.B.mip_count > 0 ) TEX = IMAGES[i].U.B.MIPS[0];
+								else TEX = IMAGES[i].U.B.PREVIEW;
+							}
+							break;
+
+						case ANIMATION:
+							TEX = IMAGES[i].U.A.TEXTURE;
+							IMAGES[i].U.A.SHOWN = IMAGES[i].U.A.FRAME;
+							break;
+					}
+
+					if( TEX || TILES || SVG ) loose[ loose_n++ ] = (Loose_Draw){ TEX, TILES, DST, SVG, IMAGES[i].RCT.w };
 				}
 
-				//set a contrasting color
-				if( sel_bg > 2 ) SDL_SetRenderDrawColor( R, bg[0].r, bg[0].g, bg[0].b, bg[0].a );
-				else SDL_SetRenderDrawColor( R, bg[4].r, bg[4].g, bg[4].b, bg[4].a );
-				draw_corners( R, &DST, 5 );
+				for (int a = 0; a < ATLASES_N; ++a ){
+					SDL_SetTextureScaleMode( ATLASES[a].batch.texture, antialiasing );
+					flush_batch( &(ATLASES[a].batch) );
+				}
+				flush_batch( &corner_batch );
+
+				for (int l = 0; l < loose_n; ++l ){
+
+					if( loose[l].TEX == NULL ){}
+					else if( angle_i != 0 || FLIP != SDL_FLIP_NONE ){
+						SDL_RenderTextureRotated( R, loose[l].TEX, NULL, &(loose[l].DST), ANGLE, NULL, FLIP );
+					} else {
+						SDL_RenderTexture( R, loose[l].TEX, NULL, &(loose[l].DST) );
+					}
 
-				if( angle_i != 0 || FLIP != SDL_FLIP_NONE ){
-					SDL_RenderTextureRotated( R, TEX, NULL, &DST, ANGLE, NULL, FLIP );
-				} else {
-					SDL_RenderTexture( R, TEX, NULL, &DST );
+					// -1 is too many to draw at all, what's underneath is all there'll be
+					if( loose[l].TILES && render_tiles( R, loose[l].TILES, &(loose[l].DST), ANGLE, FLIP ) > 0 ){
+						tiles_pending = 1;
+					}
+					if( loose[l].SVG ){
+						render_svg_over( R, loose[l].SVG, &(loose[l].DST), loose[l].img_w, ANGLE, FLIP, bg[sel_bg] );
+					}
 				}
 			}
 
@@ -1577,17 +5228,51 @@ int main(int argc, char *argv[]){
 			SDL_RenderPresent( R );
 		}
 
-		SDL_framerateDelay( 16 );
+		// held keys and drags redraw every frame, paced by the presents. Otherwise it's a nap until
+		// an event, a worker's wake or the next animation frame, whichever comes first
+		if( first > 0 || tiles_pending || nav_step || mmpan || zoom_in || zoom_out || pan_up || pan_down || pan_left || pan_right ){
+			wait = 0;
+			if( !vsync ) SDL_framerateDelay( 16 );
+		}
+		else{
+			wait = -1;
+			if( animating && next_frame > 0 ){// rounded up, waking early would just mean going round for nothing
+				Uint64 now = SDL_GetTicksNS();
+				wait = next_frame > now ? ( next_frame - now + SDL_NS_PER_MS - 1 ) / SDL_NS_PER_MS : 0;
+			}
+			if( SCAN ) wait = wait < 0 ? 250 : SDL_min( wait, 250 );// the title counts along
+			if( WAKE_EVENT == 0 ) wait = wait < 0 ? 16 : SDL_min( wait, 16 );// no way to be woken
+		}
 
 	}//>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>> / L O O P <<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<
 
+	// the scan's jobs and the watcher still read folderpath, and the grid's the listing
+	if( SCAN ) finish_folder_scan( SCAN, NULL, NULL, NULL, NULL );
+	if( WATCH ) stop_folder_watcher( WATCH );
+	if( GRID ) destroy_thumb_grid( GRID );
 	SDL_free( folderpath );
-	destroy_str_vec( &directory_list );
+	free_folderlist( &directory_list, &directory_strings, &directory_index );
 
+	drain_batch();
 	for (int i = 0; i < IMAGES_N; ++i ){
 		destroy_Image( IMAGES + i );
 	}
 	SDL_free( IMAGES );
+	free_atlases();
+	free_batch( &corner_batch );
+	SDL_free( loose );
+	free_layout_index( &layout );
+	free_packing();
+
+	// everything with jobs of its own waits them out while there's still a pool to run them
+	cancel_loads();
+	forget_prefetched();
+	deinit_recent_images();
+	destroy_worker_pool( POOL );
+	POOL = NULL;
+	drain_loads();
+	deinit_prefetcher();
+	SDL_free( thumb_dir );
 
 	SDL_DestroyRenderer( R );
 	SDL_DestroyWindow( window );